@@ -0,0 +1,169 @@
+/* x86_64_v3.c -- deflate strategies and inflate_fast for the x86-64-v3 microarchitecture level
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+#include "zbuild.h"
+
+#ifdef X86_64_V3
+
+/* This file is compiled with -march=x86-64-v3, so AVX2, BMI1, BMI2 and LZCNT are used throughout the strategies and
+ * inflate_fast, not only in the kernels. The kernels are instantiated here under their own names, so that the
+ * strategies and inflate_fast call them directly instead of through the functable, and inline them. Since the hash
+ * and chunk functions have to agree with the ones deflate and inflate use elsewhere, the functable only chooses
+ * these variants while it uses the SSE4.2 and AVX2 kernels too.
+ */
+#include "fallback_builtins.h"
+#include "compare256_avx2_p.h"
+#include "insert_string_sse42_p.h"
+#include "chunkset_avx_p.h"
+
+#define DEFLATE_LONGEST_MATCH       longest_match_x86_64_v3
+#define DEFLATE_LONGEST_MATCH_SLOW  longest_match_slow_x86_64_v3
+#define DEFLATE_INSERT_STRING       insert_string_x86_64_v3
+#define DEFLATE_QUICK_INSERT_STRING quick_insert_string_x86_64_v3
+
+#define LONGEST_MATCH       longest_match_x86_64_v3
+#define COMPARE256          compare256_avx2_static
+
+#include "match_tpl.h"
+
+#define LONGEST_MATCH_SLOW
+#define LONGEST_MATCH       longest_match_slow_x86_64_v3
+#define COMPARE256          compare256_avx2_static
+
+#include "match_tpl.h"
+
+#define UPDATE_HASH         update_hash_x86_64_v3
+#define INSERT_STRING       insert_string_x86_64_v3
+#define QUICK_INSERT_STRING quick_insert_string_x86_64_v3
+
+#include "insert_string_tpl.h"
+
+#define CHUNKSIZE        chunksize_x86_64_v3
+#define CHUNKCOPY        chunkcopy_x86_64_v3
+#define CHUNKUNROLL      chunkunroll_x86_64_v3
+#define CHUNKMEMSET      chunkmemset_x86_64_v3
+#define CHUNKMEMSET_SAFE chunkmemset_safe_x86_64_v3
+
+#include "chunkset_tpl.h"
+
+/* flatten makes the compiler inline the kernels even where it would rather not, given their size */
+__attribute__((flatten)) block_state deflate_fast_generic_x86_64_v3(deflate_state *s, int flush);
+__attribute__((flatten)) block_state deflate_fast_w15_2_x86_64_v3(deflate_state *s, int flush);
+#ifndef NO_MEDIUM_STRATEGY
+__attribute__((flatten)) block_state deflate_medium_generic_x86_64_v3(deflate_state *s, int flush);
+__attribute__((flatten)) block_state deflate_medium_w15_3_x86_64_v3(deflate_state *s, int flush);
+__attribute__((flatten)) block_state deflate_medium_w15_4_x86_64_v3(deflate_state *s, int flush);
+__attribute__((flatten)) block_state deflate_medium_w15_5_x86_64_v3(deflate_state *s, int flush);
+__attribute__((flatten)) block_state deflate_medium_w15_6_x86_64_v3(deflate_state *s, int flush);
+#endif
+__attribute__((flatten)) block_state deflate_slow_x86_64_v3(deflate_state *s, int flush);
+__attribute__((flatten)) void inflate_fast_x86_64_v3(PREFIX3(stream) *strm, unsigned long start);
+
+#define DEFLATE_FAST deflate_fast_generic_x86_64_v3
+
+#include "deflate_fast_tpl.h"
+
+#define DEFLATE_MEDIUM deflate_medium_generic_x86_64_v3
+
+#include "deflate_medium_tpl.h"
+
+#define DEFLATE_SLOW deflate_slow_x86_64_v3
+
+#include "deflate_slow_tpl.h"
+
+/* Most streams use windowBits 15 and a level's parameters as they are in configuration_table, so the levels that
+ * deflate_fast and deflate_medium serve by default get instances with those folded into constants.
+ */
+#define DEFLATE_SPEC_W_BITS        15
+#define DEFLATE_SPEC_COMPARE256    compare256_avx2_static
+
+#define DEFLATE_SPEC_LEVEL         2
+#define DEFLATE_SPEC_GOOD          4
+#define DEFLATE_SPEC_LAZY          4
+#define DEFLATE_SPEC_NICE          8
+#define DEFLATE_SPEC_CHAIN         4
+#define DEFLATE_SPEC_USABLE        deflate_fast_w15_2_usable
+#define DEFLATE_SPEC_LONGEST_MATCH longest_match_w15_2_x86_64_v3
+#define DEFLATE_FAST               deflate_fast_w15_2_x86_64_v3
+
+#include "deflate_spec_tpl.h"
+
+#ifndef NO_MEDIUM_STRATEGY
+#define DEFLATE_SPEC_LEVEL         3
+#define DEFLATE_SPEC_GOOD          4
+#define DEFLATE_SPEC_LAZY          6
+#define DEFLATE_SPEC_NICE          16
+#define DEFLATE_SPEC_CHAIN         6
+#define DEFLATE_SPEC_USABLE        deflate_medium_w15_3_usable
+#define DEFLATE_SPEC_LONGEST_MATCH longest_match_w15_3_x86_64_v3
+#define DEFLATE_MEDIUM             deflate_medium_w15_3_x86_64_v3
+
+#include "deflate_spec_tpl.h"
+
+#define DEFLATE_SPEC_LEVEL         4
+#define DEFLATE_SPEC_GOOD          4
+#define DEFLATE_SPEC_LAZY          12
+#define DEFLATE_SPEC_NICE          32
+#define DEFLATE_SPEC_CHAIN         24
+#define DEFLATE_SPEC_USABLE        deflate_medium_w15_4_usable
+#define DEFLATE_SPEC_LONGEST_MATCH longest_match_w15_4_x86_64_v3
+#define DEFLATE_MEDIUM             deflate_medium_w15_4_x86_64_v3
+
+#include "deflate_spec_tpl.h"
+
+#define DEFLATE_SPEC_LEVEL         5
+#define DEFLATE_SPEC_GOOD          8
+#define DEFLATE_SPEC_LAZY          16
+#define DEFLATE_SPEC_NICE          32
+#define DEFLATE_SPEC_CHAIN         32
+#define DEFLATE_SPEC_USABLE        deflate_medium_w15_5_usable
+#define DEFLATE_SPEC_LONGEST_MATCH longest_match_w15_5_x86_64_v3
+#define DEFLATE_MEDIUM             deflate_medium_w15_5_x86_64_v3
+
+#include "deflate_spec_tpl.h"
+
+#define DEFLATE_SPEC_LEVEL         6
+#define DEFLATE_SPEC_GOOD          8
+#define DEFLATE_SPEC_LAZY          16
+#define DEFLATE_SPEC_NICE          128
+#define DEFLATE_SPEC_CHAIN         128
+#define DEFLATE_SPEC_USABLE        deflate_medium_w15_6_usable
+#define DEFLATE_SPEC_LONGEST_MATCH longest_match_w15_6_x86_64_v3
+#define DEFLATE_MEDIUM             deflate_medium_w15_6_x86_64_v3
+
+#include "deflate_spec_tpl.h"
+#endif
+
+/* The specialized instances are only valid for streams whose parameters they were built with, anything else, such
+ * as other window sizes or parameters changed by deflateTune(), runs the generic one.
+ */
+block_state deflate_fast_x86_64_v3(deflate_state *s, int flush) {
+    if (deflate_fast_w15_2_usable(s))
+        return deflate_fast_w15_2_x86_64_v3(s, flush);
+    return deflate_fast_generic_x86_64_v3(s, flush);
+}
+
+#ifndef NO_MEDIUM_STRATEGY
+block_state deflate_medium_x86_64_v3(deflate_state *s, int flush) {
+    if (deflate_medium_w15_3_usable(s))
+        return deflate_medium_w15_3_x86_64_v3(s, flush);
+    if (deflate_medium_w15_4_usable(s))
+        return deflate_medium_w15_4_x86_64_v3(s, flush);
+    if (deflate_medium_w15_5_usable(s))
+        return deflate_medium_w15_5_x86_64_v3(s, flush);
+    if (deflate_medium_w15_6_usable(s))
+        return deflate_medium_w15_6_x86_64_v3(s, flush);
+    return deflate_medium_generic_x86_64_v3(s, flush);
+}
+#endif
+
+#define INFLATE_CHUNKCOPY        chunkcopy_x86_64_v3
+#define INFLATE_CHUNKUNROLL      chunkunroll_x86_64_v3
+#define INFLATE_CHUNKMEMSET      chunkmemset_x86_64_v3
+#define INFLATE_CHUNKMEMSET_SAFE chunkmemset_safe_x86_64_v3
+
+#define INFLATE_FAST inflate_fast_x86_64_v3
+
+#include "inffast_tpl.h"
+
+#endif
@@ -21,6 +21,7 @@
 Z_INTERNAL int x86_cpu_has_avx2;
 Z_INTERNAL int x86_cpu_has_avx512;
 Z_INTERNAL int x86_cpu_has_avx512vnni;
+Z_INTERNAL int x86_cpu_has_bmi2;
 Z_INTERNAL int x86_cpu_has_sse2;
 Z_INTERNAL int x86_cpu_has_ssse3;
 Z_INTERNAL int x86_cpu_has_sse41;
@@ -28,6 +29,7 @@ Z_INTERNAL int x86_cpu_has_sse42;
 Z_INTERNAL int x86_cpu_has_pclmulqdq;
 Z_INTERNAL int x86_cpu_has_vpclmulqdq;
 Z_INTERNAL int x86_cpu_has_tzcnt;
+Z_INTERNAL int x86_cpu_has_x86_64_v3;
 
 static void cpuid(int info, unsigned* eax, unsigned* ebx, unsigned* ecx, unsigned* edx) {
 #ifdef _MSC_VER
@@ -59,10 +61,11 @@ static void cpuidex(int info, int subinfo, unsigned* eax, unsigned* ebx, unsigne
 
 void Z_INTERNAL x86_check_features(void) {
     unsigned eax, ebx, ecx, edx;
-    unsigned maxbasic;
+    unsigned maxbasic, maxextended, procinfo_ecx;
 
     cpuid(0, &maxbasic, &ebx, &ecx, &edx);
     cpuid(1 /*CPU_PROCINFO_AND_FEATUREBITS*/, &eax, &ebx, &ecx, &edx);
+    procinfo_ecx = ecx;
 
     x86_cpu_has_sse2 = edx & 0x4000000;
     x86_cpu_has_ssse3 = ecx & 0x200;
@@ -76,6 +79,8 @@ void Z_INTERNAL x86_check_features(void) {
         // check BMI1 bit
         // Reference: https://software.intel.com/sites/default/files/article/405250/how-to-detect-new-instruction-support-in-the-4th-generation-intel-core-processor-family.pdf
         x86_cpu_has_tzcnt = ebx & 0x8;
+        // check BMI2 bit
+        x86_cpu_has_bmi2 = ebx & 0x100;
         // check AVX2 bit
         x86_cpu_has_avx2 = ebx & 0x20;
         x86_cpu_has_avx512 = ebx & 0x00010000;
@@ -83,7 +88,19 @@ void Z_INTERNAL x86_check_features(void) {
         x86_cpu_has_vpclmulqdq = ecx & 0x400;
     } else {
         x86_cpu_has_tzcnt = 0;
+        x86_cpu_has_bmi2 = 0;
         x86_cpu_has_avx2 = 0;
         x86_cpu_has_vpclmulqdq = 0;
     }
+
+    // x86-64-v3 also needs FMA, MOVBE, POPCNT and F16C from leaf 1, and LZCNT from the extended leaf 0x80000001
+    x86_cpu_has_x86_64_v3 = 0;
+    if (x86_cpu_has_avx2 && x86_cpu_has_bmi2 && x86_cpu_has_tzcnt && x86_cpu_has_sse42 &&
+        (procinfo_ecx & 0x20c01000) == 0x20c01000) {
+        cpuid((int)0x80000000, &maxextended, &ebx, &ecx, &edx);
+        if (maxextended >= 0x80000001) {
+            cpuid((int)0x80000001, &eax, &ebx, &ecx, &edx);
+            x86_cpu_has_x86_64_v3 = (ecx & 0x20) != 0;
+        }
+    }
 }
@@ -9,6 +9,7 @@
 extern int x86_cpu_has_avx2;
 extern int x86_cpu_has_avx512;
 extern int x86_cpu_has_avx512vnni;
+extern int x86_cpu_has_bmi2;
 extern int x86_cpu_has_sse2;
 extern int x86_cpu_has_ssse3;
 extern int x86_cpu_has_sse41;
@@ -16,6 +17,7 @@ extern int x86_cpu_has_sse42;
 extern int x86_cpu_has_pclmulqdq;
 extern int x86_cpu_has_vpclmulqdq;
 extern int x86_cpu_has_tzcnt;
+extern int x86_cpu_has_x86_64_v3;
 
 void Z_INTERNAL x86_check_features(void);
 
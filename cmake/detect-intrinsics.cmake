@@ -492,6 +492,27 @@ macro(check_sse42_intrinsics)
     set(CMAKE_REQUIRED_FLAGS)
 endmacro()
 
+macro(check_x86_64_v3_compiler_flag)
+    if(CMAKE_C_COMPILER_ID MATCHES "GNU" OR CMAKE_C_COMPILER_ID MATCHES "Clang")
+        if(NOT NATIVEFLAG)
+            set(X86_64_V3FLAG "-march=x86-64-v3")
+        endif()
+    endif()
+    # Check whether compiler supports the x86-64-v3 microarchitecture level
+    set(CMAKE_REQUIRED_FLAGS "${X86_64_V3FLAG} ${NATIVEFLAG}")
+    check_c_source_compiles(
+        "#include <immintrin.h>
+        int main(void) {
+            __m256i x = _mm256_set1_epi16(2);
+            unsigned int y = _bzhi_u32(0xffffffff, 7);
+            (void)x;
+            return (int)y;
+        }"
+        HAVE_X86_64_V3_FLAG FAIL_REGEX "not supported|unknown|bad value"
+    )
+    set(CMAKE_REQUIRED_FLAGS)
+endmacro()
+
 macro(check_vgfma_intrinsics)
     if(NOT NATIVEFLAG)
         set(VGFMAFLAG "-march=z13")
@@ -5,6 +5,7 @@
 
 #include "zbuild.h"
 #include "zutil.h"
+#include "zthread.h"
 
 /* ===========================================================================
  *  Architecture-specific hooks.
@@ -17,6 +18,35 @@
 #  define DEFLATE_BOUND_COMPLEN(source_len) 0
 #endif
 
+/* ===========================================================================
+ * Compresses source into at most left bytes at dest with a stream that is
+ * newly initialized or reset, leaving the compressed length in total_out.
+ */
+static int compress_stream(PREFIX3(stream) *stream, unsigned char *dest, z_size_t left,
+                           const unsigned char *source, z_size_t sourceLen) {
+    int err;
+    const unsigned int max = (unsigned int)-1;
+
+    stream->next_out = dest;
+    stream->avail_out = 0;
+    stream->next_in = (z_const unsigned char *)source;
+    stream->avail_in = 0;
+
+    do {
+        if (stream->avail_out == 0) {
+            stream->avail_out = left > (unsigned long)max ? max : (unsigned int)left;
+            left -= stream->avail_out;
+        }
+        if (stream->avail_in == 0) {
+            stream->avail_in = sourceLen > (unsigned long)max ? max : (unsigned int)sourceLen;
+            sourceLen -= stream->avail_in;
+        }
+        err = PREFIX(deflate)(stream, sourceLen ? Z_NO_FLUSH : Z_FINISH);
+    } while (err == Z_OK);
+
+    return err == Z_STREAM_END ? Z_OK : err;
+}
+
 /* ===========================================================================
      Compresses the source buffer into the destination buffer. The level
    parameter has the same meaning as in deflateInit.  sourceLen is the byte
@@ -32,7 +62,6 @@ int Z_EXPORT PREFIX(compress2)(unsigned char *dest, z_size_t *destLen, const uns
                         z_size_t sourceLen, int level) {
     PREFIX3(stream) stream;
     int err;
-    const unsigned int max = (unsigned int)-1;
     z_size_t left;
 
     left = *destLen;
@@ -46,26 +75,10 @@ int Z_EXPORT PREFIX(compress2)(unsigned char *dest, z_size_t *destLen, const uns
     if (err != Z_OK)
         return err;
 
-    stream.next_out = dest;
-    stream.avail_out = 0;
-    stream.next_in = (z_const unsigned char *)source;
-    stream.avail_in = 0;
-
-    do {
-        if (stream.avail_out == 0) {
-            stream.avail_out = left > (unsigned long)max ? max : (unsigned int)left;
-            left -= stream.avail_out;
-        }
-        if (stream.avail_in == 0) {
-            stream.avail_in = sourceLen > (unsigned long)max ? max : (unsigned int)sourceLen;
-            sourceLen -= stream.avail_in;
-        }
-        err = PREFIX(deflate)(&stream, sourceLen ? Z_NO_FLUSH : Z_FINISH);
-    } while (err == Z_OK);
-
+    err = compress_stream(&stream, dest, left, source, sourceLen);
     *destLen = (z_size_t)stream.total_out;
     PREFIX(deflateEnd)(&stream);
-    return err == Z_STREAM_END ? Z_OK : err;
+    return err;
 }
 
 /* ===========================================================================
@@ -96,3 +109,82 @@ z_size_t Z_EXPORT PREFIX(compressBound)(z_size_t sourceLen) {
     return sourceLen + (sourceLen >> 4) + 7 + ZLIB_WRAPLEN;
 #endif
 }
+
+#ifndef ZLIB_COMPAT
+typedef struct {
+    zng_batch_item *items;
+    size_t count;
+    size_t next;            /* next item to compress */
+    int32_t level;
+    zmutex lock;            /* protects next */
+} compress_batch;
+
+/* ===========================================================================
+ * Compresses items of a batch with one stream, reset between items, until
+ * all of them are taken.
+ */
+static void compress_batch_worker(void *arg) {
+    compress_batch *batch = (compress_batch *)arg;
+    zng_batch_item *item;
+    zng_stream stream;
+    size_t i;
+    int used = 0;
+
+    stream.zalloc = NULL;
+    stream.zfree = NULL;
+    stream.opaque = NULL;
+
+    /* leave the items to the other workers if this one has no memory */
+    if (zng_deflateInit(&stream, batch->level) != Z_OK)
+        return;
+
+    for (;;) {
+        zmutex_lock(&batch->lock);
+        i = batch->next++;
+        zmutex_unlock(&batch->lock);
+        if (i >= batch->count)
+            break;
+
+        item = &batch->items[i];
+        if (used)
+            zng_deflateReset(&stream);
+        item->status = compress_stream(&stream, item->dest, item->dest_len, item->src, item->src_len);
+        item->dest_len = (size_t)stream.total_out;
+        used = 1;
+    }
+    zng_deflateEnd(&stream);
+}
+
+/* ===========================================================================
+ * Compresses every item of the batch, on up to threads threads.
+ */
+int32_t Z_EXPORT zng_compress_batch(zng_batch_item *items, size_t count, int32_t level, int32_t threads) {
+    compress_batch batch;
+    size_t i;
+
+    if (items == NULL && count != 0)
+        return Z_STREAM_ERROR;
+    if (level != Z_DEFAULT_COMPRESSION && (level < 0 || level > 9))
+        return Z_STREAM_ERROR;
+
+    /* items no worker gets to for lack of memory keep this */
+    for (i = 0; i < count; i++)
+        items[i].status = Z_MEM_ERROR;
+    if (count == 0)
+        return Z_OK;
+
+    batch.items = items;
+    batch.count = count;
+    batch.next = 0;
+    batch.level = level;
+    zmutex_init(&batch.lock);
+    zthread_run(compress_batch_worker, &batch, (int32_t)MIN((size_t)MAX(threads, 1), count));
+    zmutex_destroy(&batch.lock);
+
+    for (i = 0; i < count; i++) {
+        if (items[i].status != Z_OK)
+            return items[i].status;
+    }
+    return Z_OK;
+}
+#endif
@@ -7,10 +7,38 @@
 
 #include "cpu_features.h"
 
-Z_INTERNAL void cpu_check_features(void) {
-    static int features_checked = 0;
-    if (features_checked)
-        return;
+/* Features that can be named in ZLIBNG_CPU and zng_set_cpu_features() */
+static const struct {
+    const char *name;
+    int *has;
+} cpu_features[] = {
+#if defined(X86_FEATURES)
+    { "sse2", &x86_cpu_has_sse2 },
+    { "ssse3", &x86_cpu_has_ssse3 },
+    { "sse41", &x86_cpu_has_sse41 },
+    { "sse42", &x86_cpu_has_sse42 },
+    { "pclmulqdq", &x86_cpu_has_pclmulqdq },
+    { "vpclmulqdq", &x86_cpu_has_vpclmulqdq },
+    { "avx2", &x86_cpu_has_avx2 },
+    { "avx512", &x86_cpu_has_avx512 },
+    { "avx512vnni", &x86_cpu_has_avx512vnni },
+    { "bmi2", &x86_cpu_has_bmi2 },
+    { "tzcnt", &x86_cpu_has_tzcnt },
+    { "x86_64_v3", &x86_cpu_has_x86_64_v3 },
+#elif defined(ARM_FEATURES)
+    { "neon", &arm_cpu_has_neon },
+    { "crc32", &arm_cpu_has_crc32 },
+#elif defined(PPC_FEATURES) || defined(POWER_FEATURES)
+    { "altivec", &power_cpu_has_altivec },
+    { "power8", &power_cpu_has_arch_2_07 },
+    { "power9", &power_cpu_has_arch_3_00 },
+#elif defined(S390_FEATURES)
+    { "vx", &PREFIX(s390_cpu_has_vx) },
+#endif
+    { NULL, NULL }
+};
+
+Z_INTERNAL void cpu_detect_features(void) {
 #if defined(X86_FEATURES)
     x86_check_features();
 #elif defined(ARM_FEATURES)
@@ -20,5 +48,86 @@ Z_INTERNAL void cpu_check_features(void) {
 #elif defined(S390_FEATURES)
     PREFIX(s390_check_features)();
 #endif
+}
+
+/* Finds the feature named by the len characters at name, returns -1 if there is none */
+static int cpu_find_feature(const char *name, size_t len) {
+    int i;
+
+    for (i = 0; cpu_features[i].name != NULL; i++) {
+        if (strlen(cpu_features[i].name) == len && memcmp(cpu_features[i].name, name, len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* Restricts the detected features to a comma separated list. "-name" removes a feature, "name" adds it back if
+ * it was detected, and "all" and "none" select all detected features or none of them. A list that starts with a
+ * feature name keeps only the features it names. Unknown names are skipped if apply, otherwise the list is only
+ * checked and -1 is returned if it has an unknown name.
+ */
+static int cpu_parse_features(const char *spec, int apply) {
+    int detected[sizeof(cpu_features) / sizeof(cpu_features[0])];
+    const char *p, *end;
+    int i;
+
+    for (i = 0; cpu_features[i].name != NULL; i++)
+        detected[i] = *cpu_features[i].has;
+
+    for (p = spec; *p != 0; p = *end ? end + 1 : end) {
+        int remove = (*p == '-');
+        size_t len;
+
+        for (end = p + remove; *end != 0 && *end != ','; end++);
+        len = (size_t)(end - p - remove);
+        if (len == 0)
+            continue;
+
+        if ((len == 3 && memcmp(p + remove, "all", 3) == 0) || (len == 4 && memcmp(p + remove, "none", 4) == 0)) {
+            int keep = (len == 3) != remove;
+            for (i = 0; apply && cpu_features[i].name != NULL; i++)
+                *cpu_features[i].has = keep && detected[i];
+            continue;
+        }
+        i = cpu_find_feature(p + remove, len);
+        if (i < 0) {
+            if (!apply)
+                return -1;
+            continue;
+        }
+        if (apply) {
+            if (p == spec && !remove) {
+                int j;
+                for (j = 0; cpu_features[j].name != NULL; j++)
+                    *cpu_features[j].has = 0;
+            }
+            *cpu_features[i].has = !remove && detected[i];
+        }
+    }
+    return 0;
+}
+
+Z_INTERNAL void cpu_check_features(void) {
+    static int features_checked = 0;
+    const char *spec;
+
+    if (features_checked)
+        return;
+    cpu_detect_features();
+    spec = getenv("ZLIBNG_CPU");
+    if (spec != NULL)
+        cpu_parse_features(spec, 1);
     features_checked = 1;
 }
+
+Z_INTERNAL int cpu_set_features(const char *spec) {
+    cpu_check_features();
+    if (spec != NULL && cpu_parse_features(spec, 0) != 0)
+        return -1;
+    cpu_detect_features();
+    if (spec == NULL)
+        spec = getenv("ZLIBNG_CPU");
+    if (spec != NULL)
+        cpu_parse_features(spec, 1);
+    return 0;
+}
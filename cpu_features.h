@@ -21,6 +21,8 @@
 #endif
 
 extern void cpu_check_features(void);
+extern void cpu_detect_features(void);
+extern int cpu_set_features(const char *spec);
 
 /* adler32 */
 typedef uint32_t (*adler32_func)(uint32_t adler, const uint8_t *buf, uint64_t len);
@@ -48,6 +50,49 @@ extern uint32_t adler32_avx512_vnni(uint32_t adler, const uint8_t *buf, uint64_t
 extern uint32_t adler32_power8(uint32_t adler, const uint8_t *buf, uint64_t len);
 #endif
 
+/* The adler32 variants as X(name, cpu_has, func), from the generic one to the most preferred one. The functable and
+ * the IFUNC resolver both choose from this list, so that they prefer the same one.
+ */
+#ifdef ARM_NEON_ADLER32
+#  define ADLER32_NEON(X) X("neon", &arm_cpu_has_neon, adler32_neon)
+#else
+#  define ADLER32_NEON(X)
+#endif
+#ifdef X86_SSSE3_ADLER32
+#  define ADLER32_SSSE3(X) X("ssse3", &x86_cpu_has_ssse3, adler32_ssse3)
+#else
+#  define ADLER32_SSSE3(X)
+#endif
+#ifdef X86_AVX2_ADLER32
+#  define ADLER32_AVX2(X) X("avx2", &x86_cpu_has_avx2, adler32_avx2)
+#else
+#  define ADLER32_AVX2(X)
+#endif
+#ifdef X86_AVX512_ADLER32
+#  define ADLER32_AVX512(X) X("avx512", &x86_cpu_has_avx512, adler32_avx512)
+#else
+#  define ADLER32_AVX512(X)
+#endif
+#ifdef X86_AVX512VNNI_ADLER32
+#  define ADLER32_AVX512VNNI(X) X("avx512_vnni", &x86_cpu_has_avx512vnni, adler32_avx512_vnni)
+#else
+#  define ADLER32_AVX512VNNI(X)
+#endif
+#ifdef PPC_VMX_ADLER32
+#  define ADLER32_VMX(X) X("vmx", &power_cpu_has_altivec, adler32_vmx)
+#else
+#  define ADLER32_VMX(X)
+#endif
+#ifdef POWER8_VSX_ADLER32
+#  define ADLER32_POWER8(X) X("power8", &power_cpu_has_arch_2_07, adler32_power8)
+#else
+#  define ADLER32_POWER8(X)
+#endif
+
+#define ADLER32_VARIANTS(X) \
+    X("c", NULL, adler32_c) ADLER32_NEON(X) ADLER32_SSSE3(X) ADLER32_AVX2(X) ADLER32_AVX512(X) \
+    ADLER32_AVX512VNNI(X) ADLER32_VMX(X) ADLER32_POWER8(X)
+
 /* adler32 folding */
 #ifdef X86_SSE42_ADLER32
 extern uint32_t adler32_fold_copy_sse42(uint32_t adler, uint8_t *dst, const uint8_t *src, uint64_t len);
@@ -122,6 +167,28 @@ extern uint32_t crc32_power8(uint32_t crc, const uint8_t *buf, uint64_t len);
 extern uint32_t PREFIX(s390_crc32_vx)(uint32_t crc, const uint8_t *buf, uint64_t len);
 #endif
 
+/* The crc32 variants as X(name, cpu_has, func), like ADLER32_VARIANTS */
+#if defined(ARM_ACLE_CRC_HASH)
+#  define CRC32_ARCH(X) X("acle", &arm_cpu_has_crc32, crc32_acle)
+#elif defined(POWER8_VSX_CRC32)
+#  define CRC32_ARCH(X) X("power8", &power_cpu_has_arch_2_07, crc32_power8)
+#elif defined(S390_CRC32_VX)
+#  define CRC32_ARCH(X) X("vx", &PREFIX(s390_cpu_has_vx), PREFIX(s390_crc32_vx))
+#elif defined(X86_PCLMULQDQ_CRC)
+#  define CRC32_ARCH(X) X("pclmulqdq", &x86_cpu_has_pclmulqdq, crc32_pclmulqdq)
+#else
+#  define CRC32_ARCH(X)
+#endif
+
+#define CRC32_VARIANTS(X) \
+    X("braid", NULL, crc32_braid) CRC32_ARCH(X)
+
+#ifdef WITH_IFUNC
+/* The IFUNC resolvers of the exported checksum functions, in functable.c */
+extern adler32_func adler32_resolve(void);
+extern crc32_func crc32_resolve(void);
+#endif
+
 /* compare256 */
 typedef uint32_t (*compare256_func)(const uint8_t *src0, const uint8_t *src1);
 
@@ -148,7 +215,31 @@ extern uint32_t compare256_neon(const uint8_t *src0, const uint8_t *src1);
 extern uint32_t compare256_power9(const uint8_t *src0, const uint8_t *src1);
 #endif
 
+#ifdef INFLATE_H_
+/* inflate_fast */
+typedef void (*inflate_fast_func)(PREFIX3(stream) *strm, unsigned long start);
+
+extern void inflate_fast_c(PREFIX3(stream) *strm, unsigned long start);
+#ifdef X86_64_V3
+extern void inflate_fast_x86_64_v3(PREFIX3(stream) *strm, unsigned long start);
+#endif
+#endif
+
 #ifdef DEFLATE_H_
+/* deflate strategies */
+extern block_state deflate_fast(deflate_state *s, int flush);
+#ifndef NO_MEDIUM_STRATEGY
+extern block_state deflate_medium(deflate_state *s, int flush);
+#endif
+extern block_state deflate_slow(deflate_state *s, int flush);
+#ifdef X86_64_V3
+extern block_state deflate_fast_x86_64_v3(deflate_state *s, int flush);
+#ifndef NO_MEDIUM_STRATEGY
+extern block_state deflate_medium_x86_64_v3(deflate_state *s, int flush);
+#endif
+extern block_state deflate_slow_x86_64_v3(deflate_state *s, int flush);
+#endif
+
 /* insert_string */
 extern void insert_string_c(deflate_state *const s, const uint32_t str, uint32_t count);
 #ifdef X86_SSE42_CRC_HASH
@@ -52,6 +52,15 @@
 #include "deflate.h"
 #include "deflate_p.h"
 #include "functable.h"
+#include "zprobe.h"
+
+#ifdef WITH_STATS
+#  ifdef _WIN32
+#    include <windows.h>
+#  else
+#    include <time.h>
+#  endif
+#endif
 
 /* Avoid conflicts with zlib.h macros */
 #ifdef ZLIB_COMPAT
@@ -195,7 +204,7 @@ int32_t ZNG_CONDEXPORT PREFIX(deflateInit2)(PREFIX3(stream) *strm, int32_t level
     deflate_state *s;
     int wrap = 1;
 
-    cpu_check_features();
+    functable_init();
 
     if (strm == NULL)
         return Z_STREAM_ERROR;
@@ -315,6 +324,9 @@ int32_t ZNG_CONDEXPORT PREFIX(deflateInit2)(PREFIX3(stream) *strm, int32_t level
     s->strategy = strategy;
     s->block_open = 0;
     s->reproducible = 0;
+#ifdef WITH_STATS
+    s->stats = 0;
+#endif
 
     return PREFIX(deflateReset)(strm);
 }
@@ -471,6 +483,11 @@ int32_t Z_EXPORT PREFIX(deflateResetKeep)(PREFIX3(stream) *strm) {
 #endif
         strm->adler = ADLER32_INITIAL_VALUE;
     s->last_flush = -2;
+    s->block_open = 0;
+#ifdef WITH_STATS
+    s->chain_run = 0;
+    memset(&s->stat, 0, sizeof(s->stat));
+#endif
 
     zng_tr_init(s);
 
@@ -566,7 +583,9 @@ int32_t Z_EXPORT PREFIX(deflateParams)(PREFIX3(stream) *strm, int32_t level, int
     if (s->level != level) {
         if (s->level == 0 && s->matches != 0) {
             if (s->matches == 1) {
+                PROBE1(slide_hash, s->w_size);
                 functable.slide_hash(s);
+                DEFLATE_STAT(s, slide_hash_calls, 1);
             } else {
                 CLEAR_HASH(s);
             }
@@ -714,6 +733,69 @@ Z_INTERNAL void PREFIX(flush_pending)(PREFIX3(stream) *strm) {
             strm->adler = PREFIX(crc32)(strm->adler, s->pending_buf + (beg), s->pending - (beg)); \
     } while (0)
 
+#ifdef WITH_STATS
+/* ===========================================================================
+ * Returns a monotonic time in nanoseconds, for the strategy times of zng_deflateGetStats().
+ */
+static uint64_t deflate_stats_clock(void) {
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* ===========================================================================
+ * Counts a call of the current strategy that started at the given time.
+ */
+static void deflate_stats_strategy(deflate_state *s, uint64_t start) {
+    compress_func func = configuration_table[s->level].func;
+    int strategy;
+
+    if (s->level == 0)
+        strategy = Z_STATS_STORED;
+    else if (s->strategy == Z_HUFFMAN_ONLY)
+        strategy = Z_STATS_HUFFMAN;
+    else if (s->strategy == Z_RLE)
+        strategy = Z_STATS_RLE;
+    else if (func == deflate_quick)
+        strategy = Z_STATS_QUICK;
+    else if (func == deflate_fast)
+        strategy = Z_STATS_FAST;
+#ifndef NO_MEDIUM_STRATEGY
+    else if (func == deflate_medium)
+        strategy = Z_STATS_MEDIUM;
+#endif
+    else
+        strategy = Z_STATS_SLOW;
+    s->stat.strategy_calls[strategy]++;
+    s->stat.strategy_ns[strategy] += deflate_stats_clock() - start;
+}
+#endif
+
+/* ===========================================================================
+ * Runs the strategy that configuration_table chose for the level, through the
+ * functable for the strategies that are built for more than one instruction set.
+ */
+static inline block_state deflate_strategy(deflate_state *s, int flush) {
+    compress_func func = configuration_table[s->level].func;
+
+    if (func == deflate_fast)
+        return functable.deflate_fast(s, flush);
+#ifndef NO_MEDIUM_STRATEGY
+    if (func == deflate_medium)
+        return functable.deflate_medium(s, flush);
+#endif
+    if (func == deflate_slow)
+        return functable.deflate_slow(s, flush);
+    return (*func)(s, flush);
+}
+
 /* ========================================================================= */
 int32_t Z_EXPORT PREFIX(deflate)(PREFIX3(stream) *strm, int32_t flush) {
     int32_t old_flush; /* value of flush param for previous deflate call */
@@ -934,12 +1016,21 @@ int32_t Z_EXPORT PREFIX(deflate)(PREFIX3(stream) *strm, int32_t flush) {
      */
     if (strm->avail_in != 0 || s->lookahead != 0 || (flush != Z_NO_FLUSH && s->status != FINISH_STATE)) {
         block_state bstate;
+#ifdef WITH_STATS
+        uint64_t start = s->stats ? deflate_stats_clock() : 0;
+#endif
 
+        PROBE3(deflate_strategy_entry, s->level, s->strategy, flush);
         bstate = DEFLATE_HOOK(strm, flush, &bstate) ? bstate :  /* hook for IBM Z DFLTCC */
                  s->level == 0 ? deflate_stored(s, flush) :
                  s->strategy == Z_HUFFMAN_ONLY ? deflate_huff(s, flush) :
                  s->strategy == Z_RLE ? deflate_rle(s, flush) :
-                 (*(configuration_table[s->level].func))(s, flush);
+                 deflate_strategy(s, flush);
+        PROBE1(deflate_strategy_exit, bstate);
+#ifdef WITH_STATS
+        if (s->stats)
+            deflate_stats_strategy(s, start);
+#endif
 
         if (bstate == finish_started || bstate == finish_done) {
             s->status = FINISH_STATE;
@@ -1181,6 +1272,7 @@ void Z_INTERNAL fill_window(deflate_state *s) {
     unsigned int wsize = s->w_size;
 
     Assert(s->lookahead < MIN_LOOKAHEAD, "already enough lookahead");
+    PROBE2(fill_window, s->lookahead, s->strm->avail_in);
 
     do {
         more = s->window_size - s->lookahead - s->strstart;
@@ -1190,6 +1282,7 @@ void Z_INTERNAL fill_window(deflate_state *s) {
          */
         if (s->strstart >= wsize+MAX_DIST(s)) {
             memcpy(s->window, s->window+wsize, (unsigned)wsize);
+            DEFLATE_STAT(s, window_bytes_moved, wsize);
             if (s->match_start >= wsize) {
                 s->match_start -= wsize;
             } else {
@@ -1200,7 +1293,9 @@ void Z_INTERNAL fill_window(deflate_state *s) {
             s->block_start -= (int)wsize;
             if (s->insert > s->strstart)
                 s->insert = s->strstart;
+            PROBE1(slide_hash, wsize);
             functable.slide_hash(s);
+            DEFLATE_STAT(s, slide_hash_calls, 1);
             more += wsize;
         }
         if (s->strm->avail_in == 0)
@@ -1305,6 +1400,7 @@ int32_t Z_EXPORT zng_deflateSetParams(zng_stream *strm, zng_deflate_param_value
     zng_deflate_param_value *new_level = NULL;
     zng_deflate_param_value *new_strategy = NULL;
     zng_deflate_param_value *new_reproducible = NULL;
+    zng_deflate_param_value *new_stats = NULL;
     int param_buf_error;
     int version_error = 0;
     int buf_error = 0;
@@ -1333,6 +1429,9 @@ int32_t Z_EXPORT zng_deflateSetParams(zng_stream *strm, zng_deflate_param_value
             case Z_DEFLATE_REPRODUCIBLE:
                 param_buf_error = deflateSetParamPre(&new_reproducible, sizeof(int), &params[i]);
                 break;
+            case Z_DEFLATE_STATS:
+                param_buf_error = deflateSetParamPre(&new_stats, sizeof(int), &params[i]);
+                break;
             default:
                 params[i].status = Z_VERSION_ERROR;
                 version_error = 1;
@@ -1369,6 +1468,21 @@ int32_t Z_EXPORT zng_deflateSetParams(zng_stream *strm, zng_deflate_param_value
             stream_error = 1;
         }
     }
+    if (new_stats != NULL) {
+        val = *(int *)new_stats->buf;
+#ifdef WITH_STATS
+        if (val && !s->stats) {
+            s->chain_run = 0;
+            memset(&s->stat, 0, sizeof(s->stat));
+        }
+        s->stats = val != 0;
+#else
+        if (val) {
+            new_stats->status = Z_VERSION_ERROR;
+            version_error = 1;
+        }
+#endif
+    }
 
     /* Report version errors only if there are no real errors. */
     return stream_error ? Z_STREAM_ERROR : (version_error ? Z_VERSION_ERROR : Z_OK);
@@ -1410,6 +1524,16 @@ int32_t Z_EXPORT zng_deflateGetParams(zng_stream *strm, zng_deflate_param_value
                 else
                     *(int *)params[i].buf = s->reproducible;
                 break;
+            case Z_DEFLATE_STATS:
+                if (params[i].size < sizeof(int))
+                    params[i].status = Z_BUF_ERROR;
+                else
+#ifdef WITH_STATS
+                    *(int *)params[i].buf = s->stats;
+#else
+                    *(int *)params[i].buf = 0;
+#endif
+                break;
             default:
                 params[i].status = Z_VERSION_ERROR;
                 version_error = 1;
@@ -1420,4 +1544,31 @@ int32_t Z_EXPORT zng_deflateGetParams(zng_stream *strm, zng_deflate_param_value
     }
     return buf_error ? Z_BUF_ERROR : (version_error ? Z_VERSION_ERROR : Z_OK);
 }
+
+/* ========================================================================= */
+int32_t Z_EXPORT zng_deflateGetStats(zng_stream *strm, zng_deflate_stats *stats, size_t size) {
+#ifdef WITH_STATS
+    deflate_state *s;
+    zng_deflate_stats stat;
+#endif
+
+    if (deflateStateCheck(strm) || stats == NULL)
+        return Z_STREAM_ERROR;
+#ifdef WITH_STATS
+    s = strm->state;
+    if (!s->stats)
+        return Z_VERSION_ERROR;
+
+    /* the last search is only folded into chain_max when the next one starts */
+    stat = s->stat;
+    if (s->chain_run > stat.chain_max)
+        stat.chain_max = s->chain_run;
+    memset(stats, 0, size);
+    memcpy(stats, &stat, MIN(size, sizeof(stat)));
+    return Z_OK;
+#else
+    Z_UNUSED(size);
+    return Z_VERSION_ERROR;
+#endif
+}
 #endif
@@ -282,8 +282,38 @@ struct internal_state {
 
     /* Reserved for future use and alignment purposes */
     int32_t reserved[11];
+
+#ifdef WITH_STATS
+    int stats;                    /* true to collect statistics */
+    uint32_t chain_run;           /* hash chain entries walked by the last longest match search */
+    zng_deflate_stats stat;       /* statistics for zng_deflateGetStats() */
+#endif
 } ALIGNED_(8);
 
+/* Count statistics for zng_deflateGetStats() if enabled */
+#ifdef WITH_STATS
+#  define DEFLATE_STAT(s, field, n) do { if (UNLIKELY((s)->stats)) (s)->stat.field += (n); } while (0)
+/* Fold the previous search into chain_max and count a new longest match search */
+#  define DEFLATE_STAT_SEARCH(s) do { \
+        if (UNLIKELY((s)->stats)) { \
+            if ((s)->chain_run > (s)->stat.chain_max) \
+                (s)->stat.chain_max = (s)->chain_run; \
+            (s)->chain_run = 0; \
+            (s)->stat.chain_searches++; \
+        } \
+    } while (0)
+#  define DEFLATE_STAT_STEP(s) do { \
+        if (UNLIKELY((s)->stats)) { \
+            (s)->chain_run++; \
+            (s)->stat.chain_steps++; \
+        } \
+    } while (0)
+#else
+#  define DEFLATE_STAT(s, field, n) do {} while (0)
+#  define DEFLATE_STAT_SEARCH(s) do {} while (0)
+#  define DEFLATE_STAT_STEP(s) do {} while (0)
+#endif
+
 typedef enum {
     need_more,      /* block not completed, need more input or more output */
     block_done,     /* block flush performed */
@@ -0,0 +1,51 @@
+/* deflate_params_tpl.h -- Defaults for the macros that match_tpl.h and the strategy templates are built with
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* No include guard, every template includes this to fill in what its instance did not define, and
+ * deflate_spec_tpl.h undefines some of these again when it is done.
+ */
+
+/* The kernels called by the strategies. Variants built next to instances of match_tpl.h and insert_string_tpl.h can
+ * define these to call those directly, so that the compiler can inline them.
+ */
+#ifndef DEFLATE_LONGEST_MATCH
+#  define DEFLATE_LONGEST_MATCH       functable.longest_match
+#endif
+#ifndef DEFLATE_LONGEST_MATCH_SLOW
+#  define DEFLATE_LONGEST_MATCH_SLOW  functable.longest_match_slow
+#endif
+#ifndef DEFLATE_INSERT_STRING
+#  define DEFLATE_INSERT_STRING       functable.insert_string
+#endif
+#ifndef DEFLATE_QUICK_INSERT_STRING
+#  define DEFLATE_QUICK_INSERT_STRING functable.quick_insert_string
+#endif
+
+/* The stream parameters read in the inner loops. Instances built for a single set of parameters define these to
+ * constants, see deflate_spec_tpl.h.
+ */
+#ifndef DEFLATE_W_MASK
+#  define DEFLATE_W_MASK(s)      ((s)->w_mask)
+#endif
+#ifndef DEFLATE_MAX_DIST
+#  define DEFLATE_MAX_DIST(s)    MAX_DIST(s)
+#endif
+#ifndef DEFLATE_WINDOW_SIZE
+#  define DEFLATE_WINDOW_SIZE(s) ((s)->window_size)
+#endif
+#ifndef DEFLATE_LEVEL
+#  define DEFLATE_LEVEL(s)       ((s)->level)
+#endif
+#ifndef DEFLATE_GOOD_MATCH
+#  define DEFLATE_GOOD_MATCH(s)  ((s)->good_match)
+#endif
+#ifndef DEFLATE_MAX_INSERT
+#  define DEFLATE_MAX_INSERT(s)  ((s)->max_insert_length)
+#endif
+#ifndef DEFLATE_NICE_MATCH
+#  define DEFLATE_NICE_MATCH(s)  ((s)->nice_match)
+#endif
+#ifndef DEFLATE_MAX_CHAIN
+#  define DEFLATE_MAX_CHAIN(s)   ((s)->max_chain_length)
+#endif
@@ -35,6 +35,7 @@ extern const ct_data static_dtree[D_CODES];
 #define QUICK_END_BLOCK(s, last) { \
     if (s->block_open) { \
         zng_tr_emit_end_block(s, static_ltree, last); \
+        DEFLATE_STAT(s, fixed_bytes, s->strstart - s->block_start); \
         s->block_open = 0; \
         s->block_start = (int)s->strstart; \
         PREFIX(flush_pending)(s->strm); \
@@ -0,0 +1,71 @@
+/* deflate_spec_tpl.h -- Strategy instance for a single set of stream parameters
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* Builds DEFLATE_FAST or DEFLATE_MEDIUM, together with its own instance of match_tpl.h, with the window size and the
+ * level's parameters folded into constants, and DEFLATE_SPEC_USABLE() which tells whether a stream can use it. The
+ * includer defines:
+ *
+ *   DEFLATE_SPEC_W_BITS and DEFLATE_SPEC_COMPARE256, which are kept for the following instances,
+ *   DEFLATE_SPEC_LEVEL, DEFLATE_SPEC_GOOD, DEFLATE_SPEC_LAZY, DEFLATE_SPEC_NICE and DEFLATE_SPEC_CHAIN, the values
+ *   in configuration_table for the level,
+ *   DEFLATE_SPEC_USABLE and DEFLATE_SPEC_LONGEST_MATCH, the names of the functions built besides the strategy.
+ *
+ * The parameter macros and DEFLATE_LONGEST_MATCH are left undefined, so instances go after the generic ones.
+ */
+
+#undef DEFLATE_W_MASK
+#undef DEFLATE_MAX_DIST
+#undef DEFLATE_WINDOW_SIZE
+#undef DEFLATE_LEVEL
+#undef DEFLATE_GOOD_MATCH
+#undef DEFLATE_MAX_INSERT
+#undef DEFLATE_NICE_MATCH
+#undef DEFLATE_MAX_CHAIN
+#undef DEFLATE_LONGEST_MATCH
+
+#define DEFLATE_W_MASK(s)      ((1U << DEFLATE_SPEC_W_BITS) - 1)
+#define DEFLATE_MAX_DIST(s)    ((1U << DEFLATE_SPEC_W_BITS) - MIN_LOOKAHEAD)
+#define DEFLATE_WINDOW_SIZE(s) (2U << DEFLATE_SPEC_W_BITS)
+#define DEFLATE_LEVEL(s)       DEFLATE_SPEC_LEVEL
+#define DEFLATE_GOOD_MATCH(s)  DEFLATE_SPEC_GOOD
+#define DEFLATE_MAX_INSERT(s)  DEFLATE_SPEC_LAZY
+#define DEFLATE_NICE_MATCH(s)  DEFLATE_SPEC_NICE
+#define DEFLATE_MAX_CHAIN(s)   DEFLATE_SPEC_CHAIN
+#define DEFLATE_LONGEST_MATCH  DEFLATE_SPEC_LONGEST_MATCH
+
+static inline int DEFLATE_SPEC_USABLE(deflate_state *s) {
+    return s->w_bits == DEFLATE_SPEC_W_BITS && s->level == DEFLATE_SPEC_LEVEL &&
+           s->good_match == DEFLATE_SPEC_GOOD && s->max_lazy_match == DEFLATE_SPEC_LAZY &&
+           s->nice_match == DEFLATE_SPEC_NICE && s->max_chain_length == DEFLATE_SPEC_CHAIN;
+}
+
+#define LONGEST_MATCH DEFLATE_SPEC_LONGEST_MATCH
+#define COMPARE256    DEFLATE_SPEC_COMPARE256
+
+#include "match_tpl.h"
+
+#ifdef DEFLATE_FAST
+#  include "deflate_fast_tpl.h"
+#endif
+#ifdef DEFLATE_MEDIUM
+#  include "deflate_medium_tpl.h"
+#endif
+
+#undef DEFLATE_W_MASK
+#undef DEFLATE_MAX_DIST
+#undef DEFLATE_WINDOW_SIZE
+#undef DEFLATE_LEVEL
+#undef DEFLATE_GOOD_MATCH
+#undef DEFLATE_MAX_INSERT
+#undef DEFLATE_NICE_MATCH
+#undef DEFLATE_MAX_CHAIN
+#undef DEFLATE_LONGEST_MATCH
+
+#undef DEFLATE_SPEC_LEVEL
+#undef DEFLATE_SPEC_GOOD
+#undef DEFLATE_SPEC_LAZY
+#undef DEFLATE_SPEC_NICE
+#undef DEFLATE_SPEC_CHAIN
+#undef DEFLATE_SPEC_USABLE
+#undef DEFLATE_SPEC_LONGEST_MATCH
@@ -78,6 +78,7 @@ Z_INTERNAL block_state deflate_stored(deflate_state *s, int flush) {
         /* Update debugging counts for the data about to be copied. */
         cmpr_bits_add(s, len << 3);
         sent_bits_add(s, len << 3);
+        DEFLATE_STAT(s, stored_bytes, len);
 
         /* Copy uncompressed bytes from the window to next_out. */
         if (left) {
@@ -8,455 +8,461 @@
 #include "crc32_braid_p.h"
 #include "deflate.h"
 #include "deflate_p.h"
+#include "inftrees.h"
+#include "inflate.h"
 
 #include "functable.h"
+#include "zthread.h"
 
 #include "cpu_features.h"
 
-Z_INTERNAL Z_TLS struct functable_s functable;
-
-/* stub functions */
-Z_INTERNAL uint32_t update_hash_stub(deflate_state *const s, uint32_t h, uint32_t val) {
-    // Initialize default
+/* An implementation of a functable entry, and the CPU feature it needs, or NULL if it runs everywhere. Entries that
+ * have to agree with each other, like the chunk functions, are switched together as one group.
+ */
+typedef void (*functable_func)(void);
+
+typedef struct {
+    const char *name;
+    const int *cpu_has;
+    functable_func funcs[5];
+} functable_variant;
+
+typedef struct {
+    const char *name;
+    const functable_variant *variants;   /* from the generic one to the most preferred one */
+    int variant_count;
+    int func_count;
+    size_t offsets[5];                   /* of the functions in struct functable_s */
+} functable_entry;
+
+#define FT_FUNC(f)   ((functable_func)(f))
+#define FT_OFFSET(f) offsetof(struct functable_s, f)
+#define FT_COUNT(a)  ((int)(sizeof(a) / sizeof((a)[0])))
+
+#ifdef X86_FEATURES
+#  define X86_HAS(feature) &x86_cpu_has_##feature
+#endif
+
+#ifdef X86_64_V3
+/* The x86-64-v3 variants of the strategies and inflate_fast inline the SSE4.2 hash, the AVX2 longest_match and the AVX
+ * chunk functions. They are only available while the functable uses the same kernels, since the hash and chunk size
+ * have to agree with the rest of deflate and inflate, and so that they don't hide a kernel selected for testing.
+ */
+static int x86_64_v3_deflate;
+static int x86_64_v3_inflate;
+#endif
 
-    functable.update_hash = &update_hash_c;
+/* Detects the CPU features, and updates the availability of the variants that depend on the chosen kernels */
+static void functable_check_features(void) {
     cpu_check_features();
-
-#ifdef X86_SSE42_CRC_HASH
-    if (x86_cpu_has_sse42)
-        functable.update_hash = &update_hash_sse4;
-#elif defined(ARM_ACLE_CRC_HASH)
-    if (arm_cpu_has_crc32)
-        functable.update_hash = &update_hash_acle;
+#ifdef X86_64_V3
+    x86_64_v3_deflate = x86_cpu_has_x86_64_v3 && x86_cpu_has_bmi2 && x86_cpu_has_tzcnt &&
+        functable.longest_match == &longest_match_avx2 && functable.insert_string == &insert_string_sse4;
+    x86_64_v3_inflate = x86_cpu_has_x86_64_v3 && x86_cpu_has_bmi2 && x86_cpu_has_tzcnt &&
+        functable.chunkmemset == &chunkmemset_avx;
 #endif
-
-    return functable.update_hash(s, h, val);
 }
 
-Z_INTERNAL void insert_string_stub(deflate_state *const s, uint32_t str, uint32_t count) {
-    // Initialize default
+/* Expands a list of X(name, cpu_has, func) from cpu_features.h into the variants of a single function */
+#define FT_VARIANT(name, cpu_has, func) { name, cpu_has, { FT_FUNC(func) } },
 
-    functable.insert_string = &insert_string_c;
-    cpu_check_features();
+static const functable_variant adler32_variants[] = {
+    ADLER32_VARIANTS(FT_VARIANT)
+};
 
-#ifdef X86_SSE42_CRC_HASH
-    if (x86_cpu_has_sse42)
-        functable.insert_string = &insert_string_sse4;
-#elif defined(ARM_ACLE_CRC_HASH)
-    if (arm_cpu_has_crc32)
-        functable.insert_string = &insert_string_acle;
+static const functable_variant adler32_fold_copy_variants[] = {
+    { "c", NULL, { FT_FUNC(adler32_fold_copy_c) } },
+#ifdef X86_SSE42_ADLER32
+    { "sse42", X86_HAS(sse42), { FT_FUNC(adler32_fold_copy_sse42) } },
 #endif
-
-    functable.insert_string(s, str, count);
-}
-
-Z_INTERNAL Pos quick_insert_string_stub(deflate_state *const s, const uint32_t str) {
-    functable.quick_insert_string = &quick_insert_string_c;
-
-#ifdef X86_SSE42_CRC_HASH
-    if (x86_cpu_has_sse42)
-        functable.quick_insert_string = &quick_insert_string_sse4;
-#elif defined(ARM_ACLE_CRC_HASH)
-    if (arm_cpu_has_crc32)
-        functable.quick_insert_string = &quick_insert_string_acle;
+#ifdef X86_AVX2_ADLER32
+    { "avx2", X86_HAS(avx2), { FT_FUNC(adler32_fold_copy_avx2) } },
 #endif
+#ifdef X86_AVX512_ADLER32
+    { "avx512", X86_HAS(avx512), { FT_FUNC(adler32_fold_copy_avx512) } },
+#endif
+#ifdef X86_AVX512VNNI_ADLER32
+    { "avx512_vnni", X86_HAS(avx512vnni), { FT_FUNC(adler32_fold_copy_avx512_vnni) } },
+#endif
+};
 
-    return functable.quick_insert_string(s, str);
-}
-
-Z_INTERNAL void slide_hash_stub(deflate_state *s) {
+static const functable_variant crc32_variants[] = {
+    CRC32_VARIANTS(FT_VARIANT)
+};
 
-    functable.slide_hash = &slide_hash_c;
-    cpu_check_features();
+static const functable_variant crc32_fold_variants[] = {
+    { "c", NULL, { FT_FUNC(crc32_fold_reset_c), FT_FUNC(crc32_fold_copy_c), FT_FUNC(crc32_fold_c),
+                   FT_FUNC(crc32_fold_final_c) } },
+#ifdef X86_PCLMULQDQ_CRC
+    { "pclmulqdq", X86_HAS(pclmulqdq), { FT_FUNC(crc32_fold_pclmulqdq_reset), FT_FUNC(crc32_fold_pclmulqdq_copy),
+                                         FT_FUNC(crc32_fold_pclmulqdq), FT_FUNC(crc32_fold_pclmulqdq_final) } },
+#endif
+};
 
-#ifdef X86_SSE2
-#  if !defined(__x86_64__) && !defined(_M_X64) && !defined(X86_NOCHECK_SSE2)
-    if (x86_cpu_has_sse2)
+static const functable_variant compare256_variants[] = {
+    { "c", NULL, { FT_FUNC(compare256_c) } },
+#ifdef UNALIGNED_OK
+    { "unaligned_16", NULL, { FT_FUNC(compare256_unaligned_16) } },
+#  ifdef HAVE_BUILTIN_CTZ
+    { "unaligned_32", NULL, { FT_FUNC(compare256_unaligned_32) } },
 #  endif
-        functable.slide_hash = &slide_hash_sse2;
-#elif defined(ARM_NEON_SLIDEHASH)
-#  ifndef ARM_NOCHECK_NEON
-    if (arm_cpu_has_neon)
+#  if defined(UNALIGNED64_OK) && defined(HAVE_BUILTIN_CTZLL)
+    { "unaligned_64", NULL, { FT_FUNC(compare256_unaligned_64) } },
 #  endif
-        functable.slide_hash = &slide_hash_neon;
 #endif
-#ifdef X86_AVX2
-    if (x86_cpu_has_avx2)
-        functable.slide_hash = &slide_hash_avx2;
+#if defined(X86_SSE2) && defined(HAVE_BUILTIN_CTZ)
+    { "sse2", X86_HAS(sse2), { FT_FUNC(compare256_sse2) } },
 #endif
-#ifdef PPC_VMX_SLIDEHASH
-    if (power_cpu_has_altivec)
-        functable.slide_hash = &slide_hash_vmx;
+#if defined(X86_AVX2) && defined(HAVE_BUILTIN_CTZ)
+    { "avx2", X86_HAS(avx2), { FT_FUNC(compare256_avx2) } },
 #endif
-#ifdef POWER8_VSX_SLIDEHASH
-    if (power_cpu_has_arch_2_07)
-        functable.slide_hash = &slide_hash_power8;
+#ifdef POWER9
+    { "power9", &power_cpu_has_arch_3_00, { FT_FUNC(compare256_power9) } },
 #endif
+};
 
-    functable.slide_hash(s);
-}
-
-Z_INTERNAL uint32_t longest_match_stub(deflate_state *const s, Pos cur_match) {
+#define CHUNKSET_FUNCS(arch) { FT_FUNC(chunksize_##arch), FT_FUNC(chunkcopy_##arch), FT_FUNC(chunkunroll_##arch), \
+                               FT_FUNC(chunkmemset_##arch), FT_FUNC(chunkmemset_safe_##arch) }
 
-#ifdef UNALIGNED_OK
-#  if defined(UNALIGNED64_OK) && defined(HAVE_BUILTIN_CTZLL)
-    functable.longest_match = &longest_match_unaligned_64;
-#  elif defined(HAVE_BUILTIN_CTZ)
-    functable.longest_match = &longest_match_unaligned_32;
-#  else
-    functable.longest_match = &longest_match_unaligned_16;
+static const functable_variant chunkset_variants[] = {
+    { "c", NULL, CHUNKSET_FUNCS(c) },
+#ifdef X86_SSE2_CHUNKSET
+    { "sse2", X86_HAS(sse2), CHUNKSET_FUNCS(sse2) },
+#  ifdef X86_SSE41
+    { "sse41", X86_HAS(sse41), { FT_FUNC(chunksize_sse2), FT_FUNC(chunkcopy_sse2), FT_FUNC(chunkunroll_sse2),
+                                 FT_FUNC(chunkmemset_sse41), FT_FUNC(chunkmemset_safe_sse41) } },
 #  endif
-#else
-    functable.longest_match = &longest_match_c;
 #endif
-#if defined(X86_SSE2) && defined(HAVE_BUILTIN_CTZ)
-    if (x86_cpu_has_sse2)
-        functable.longest_match = &longest_match_sse2;
+#ifdef X86_AVX_CHUNKSET
+    { "avx", X86_HAS(avx2), CHUNKSET_FUNCS(avx) },
 #endif
-#if defined(X86_AVX2) && defined(HAVE_BUILTIN_CTZ)
-    if (x86_cpu_has_avx2)
-        functable.longest_match = &longest_match_avx2;
+#ifdef ARM_NEON_CHUNKSET
+    { "neon", &arm_cpu_has_neon, CHUNKSET_FUNCS(neon) },
 #endif
-#if defined(ARM_NEON) && defined(HAVE_BUILTIN_CTZLL)
-    if (arm_cpu_has_neon)
-        functable.longest_match = &longest_match_neon;
+#ifdef POWER8_VSX_CHUNKSET
+    { "power8", &power_cpu_has_arch_2_07, CHUNKSET_FUNCS(power8) },
 #endif
-#ifdef POWER9
-    if (power_cpu_has_arch_3_00)
-        functable.longest_match = &longest_match_power9;
+};
+
+#ifdef NO_MEDIUM_STRATEGY
+#  define DEFLATE_FUNCS(arch) { FT_FUNC(deflate_fast##arch), FT_FUNC(deflate_slow##arch) }
+#  define DEFLATE_FUNC_COUNT 2
+#else
+#  define DEFLATE_FUNCS(arch) { FT_FUNC(deflate_fast##arch), FT_FUNC(deflate_slow##arch), FT_FUNC(deflate_medium##arch) }
+#  define DEFLATE_FUNC_COUNT 3
 #endif
 
-    return functable.longest_match(s, cur_match);
-}
+static const functable_variant deflate_variants[] = {
+    { "c", NULL, DEFLATE_FUNCS() },
+#ifdef X86_64_V3
+    { "x86_64_v3", &x86_64_v3_deflate, DEFLATE_FUNCS(_x86_64_v3) },
+#endif
+};
 
-Z_INTERNAL uint32_t longest_match_slow_stub(deflate_state *const s, Pos cur_match) {
+static const functable_variant inflate_fast_variants[] = {
+    { "c", NULL, { FT_FUNC(inflate_fast_c) } },
+#ifdef X86_64_V3
+    { "x86_64_v3", &x86_64_v3_inflate, { FT_FUNC(inflate_fast_x86_64_v3) } },
+#endif
+};
 
+static const functable_variant insert_string_variants[] = {
+    { "c", NULL, { FT_FUNC(insert_string_c), FT_FUNC(quick_insert_string_c), FT_FUNC(update_hash_c) } },
+#ifdef X86_SSE42_CRC_HASH
+    { "sse4", X86_HAS(sse42), { FT_FUNC(insert_string_sse4), FT_FUNC(quick_insert_string_sse4),
+                                FT_FUNC(update_hash_sse4) } },
+#elif defined(ARM_ACLE_CRC_HASH)
+    { "acle", &arm_cpu_has_crc32, { FT_FUNC(insert_string_acle), FT_FUNC(quick_insert_string_acle),
+                                    FT_FUNC(update_hash_acle) } },
+#endif
+};
+
+static const functable_variant longest_match_variants[] = {
+    { "c", NULL, { FT_FUNC(longest_match_c), FT_FUNC(longest_match_slow_c) } },
 #ifdef UNALIGNED_OK
+    { "unaligned_16", NULL, { FT_FUNC(longest_match_unaligned_16), FT_FUNC(longest_match_slow_unaligned_16) } },
+#  ifdef HAVE_BUILTIN_CTZ
+    { "unaligned_32", NULL, { FT_FUNC(longest_match_unaligned_32), FT_FUNC(longest_match_slow_unaligned_32) } },
+#  endif
 #  if defined(UNALIGNED64_OK) && defined(HAVE_BUILTIN_CTZLL)
-    functable.longest_match_slow = &longest_match_slow_unaligned_64;
-#  elif defined(HAVE_BUILTIN_CTZ)
-    functable.longest_match_slow = &longest_match_slow_unaligned_32;
-#  else
-    functable.longest_match_slow = &longest_match_slow_unaligned_16;
+    { "unaligned_64", NULL, { FT_FUNC(longest_match_unaligned_64), FT_FUNC(longest_match_slow_unaligned_64) } },
 #  endif
-#else
-    functable.longest_match_slow = &longest_match_slow_c;
 #endif
 #if defined(X86_SSE2) && defined(HAVE_BUILTIN_CTZ)
-    if (x86_cpu_has_sse2)
-        functable.longest_match_slow = &longest_match_slow_sse2;
+    { "sse2", X86_HAS(sse2), { FT_FUNC(longest_match_sse2), FT_FUNC(longest_match_slow_sse2) } },
 #endif
 #if defined(X86_AVX2) && defined(HAVE_BUILTIN_CTZ)
-    if (x86_cpu_has_avx2)
-        functable.longest_match_slow = &longest_match_slow_avx2;
+    { "avx2", X86_HAS(avx2), { FT_FUNC(longest_match_avx2), FT_FUNC(longest_match_slow_avx2) } },
 #endif
 #if defined(ARM_NEON) && defined(HAVE_BUILTIN_CTZLL)
-    if (arm_cpu_has_neon)
-        functable.longest_match_slow = &longest_match_slow_neon;
+    { "neon", &arm_cpu_has_neon, { FT_FUNC(longest_match_neon), FT_FUNC(longest_match_slow_neon) } },
 #endif
 #ifdef POWER9
-    if (power_cpu_has_arch_3_00)
-        functable.longest_match_slow = &longest_match_slow_power9;
+    { "power9", &power_cpu_has_arch_3_00, { FT_FUNC(longest_match_power9), FT_FUNC(longest_match_slow_power9) } },
 #endif
+};
 
-    return functable.longest_match_slow(s, cur_match);
-}
-
-Z_INTERNAL uint32_t adler32_stub(uint32_t adler, const uint8_t *buf, uint64_t len) {
-    // Initialize default
-    functable.adler32 = &adler32_c;
-    cpu_check_features();
-
-#ifdef ARM_NEON_ADLER32
-#  ifndef ARM_NOCHECK_NEON
-    if (arm_cpu_has_neon)
-#  endif
-        functable.adler32 = &adler32_neon;
-#endif
-#ifdef X86_SSSE3_ADLER32
-    if (x86_cpu_has_ssse3)
-        functable.adler32 = &adler32_ssse3;
-#endif
-#ifdef X86_AVX2_ADLER32
-    if (x86_cpu_has_avx2)
-        functable.adler32 = &adler32_avx2;
+static const functable_variant slide_hash_variants[] = {
+    { "c", NULL, { FT_FUNC(slide_hash_c) } },
+#ifdef X86_SSE2
+    { "sse2", X86_HAS(sse2), { FT_FUNC(slide_hash_sse2) } },
+#elif defined(ARM_NEON_SLIDEHASH)
+    { "neon", &arm_cpu_has_neon, { FT_FUNC(slide_hash_neon) } },
 #endif
-#ifdef X86_AVX512_ADLER32
-    if (x86_cpu_has_avx512)
-        functable.adler32 = &adler32_avx512;
+#ifdef X86_AVX2
+    { "avx2", X86_HAS(avx2), { FT_FUNC(slide_hash_avx2) } },
 #endif
-#ifdef X86_AVX512VNNI_ADLER32
-    if (x86_cpu_has_avx512vnni) {
-        functable.adler32 = &adler32_avx512_vnni;
-    }
+#ifdef PPC_VMX_SLIDEHASH
+    { "vmx", &power_cpu_has_altivec, { FT_FUNC(slide_hash_vmx) } },
 #endif
-#ifdef PPC_VMX_ADLER32
-    if (power_cpu_has_altivec)
-        functable.adler32 = &adler32_vmx;
+#ifdef POWER8_VSX_SLIDEHASH
+    { "power8", &power_cpu_has_arch_2_07, { FT_FUNC(slide_hash_power8) } },
 #endif
-#ifdef POWER8_VSX_ADLER32
-    if (power_cpu_has_arch_2_07)
-        functable.adler32 = &adler32_power8;
+};
+
+enum {
+    FT_ADLER32,
+    FT_ADLER32_FOLD_COPY,
+    FT_CRC32,
+    FT_CRC32_FOLD,
+    FT_COMPARE256,
+    FT_CHUNKSET,
+    FT_INFLATE_FAST,
+    FT_INSERT_STRING,
+    FT_LONGEST_MATCH,
+    FT_SLIDE_HASH,
+    FT_DEFLATE,
+    FT_ENTRIES
+};
+
+/* The entries are resolved in this order, so inflate_fast and deflate come after the kernels they depend on */
+static const functable_entry functable_entries[FT_ENTRIES] = {
+    { "adler32", adler32_variants, FT_COUNT(adler32_variants), 1, { FT_OFFSET(adler32) } },
+    { "adler32_fold_copy", adler32_fold_copy_variants, FT_COUNT(adler32_fold_copy_variants), 1,
+      { FT_OFFSET(adler32_fold_copy) } },
+    { "crc32", crc32_variants, FT_COUNT(crc32_variants), 1, { FT_OFFSET(crc32) } },
+    { "crc32_fold", crc32_fold_variants, FT_COUNT(crc32_fold_variants), 4,
+      { FT_OFFSET(crc32_fold_reset), FT_OFFSET(crc32_fold_copy), FT_OFFSET(crc32_fold), FT_OFFSET(crc32_fold_final) } },
+    { "compare256", compare256_variants, FT_COUNT(compare256_variants), 1, { FT_OFFSET(compare256) } },
+    { "chunkset", chunkset_variants, FT_COUNT(chunkset_variants), 5,
+      { FT_OFFSET(chunksize), FT_OFFSET(chunkcopy), FT_OFFSET(chunkunroll), FT_OFFSET(chunkmemset),
+        FT_OFFSET(chunkmemset_safe) } },
+    { "inflate_fast", inflate_fast_variants, FT_COUNT(inflate_fast_variants), 1, { FT_OFFSET(inflate_fast) } },
+    { "insert_string", insert_string_variants, FT_COUNT(insert_string_variants), 3,
+      { FT_OFFSET(insert_string), FT_OFFSET(quick_insert_string), FT_OFFSET(update_hash) } },
+    { "longest_match", longest_match_variants, FT_COUNT(longest_match_variants), 2,
+      { FT_OFFSET(longest_match), FT_OFFSET(longest_match_slow) } },
+    { "slide_hash", slide_hash_variants, FT_COUNT(slide_hash_variants), 1, { FT_OFFSET(slide_hash) } },
+    { "deflate", deflate_variants, FT_COUNT(deflate_variants), DEFLATE_FUNC_COUNT,
+#ifdef NO_MEDIUM_STRATEGY
+      { FT_OFFSET(deflate_fast), FT_OFFSET(deflate_slow) } }
+#else
+      { FT_OFFSET(deflate_fast), FT_OFFSET(deflate_slow), FT_OFFSET(deflate_medium) } }
 #endif
+};
 
+/* Variant chosen with zng_functable_select() for each entry, plus one, or 0 to choose automatically */
+static int functable_selected[FT_ENTRIES];
+
+static int functable_available(const functable_variant *variant) {
+    return variant->cpu_has == NULL || *variant->cpu_has;
+}
+
+/* Points the functions of an entry at the selected variant if it is available, or else at the most preferred
+ * variant that the CPU supports.
+ */
+static void functable_resolve(int entry) {
+    const functable_entry *e = &functable_entries[entry];
+    const functable_variant *variant = NULL;
+    int i, selected = functable_selected[entry];
+
+    functable_check_features();
+    if (selected > 0 && functable_available(&e->variants[selected - 1])) {
+        variant = &e->variants[selected - 1];
+    } else {
+        for (i = 0; i < e->variant_count; i++) {
+            if (functable_available(&e->variants[i]))
+                variant = &e->variants[i];
+        }
+    }
+    for (i = 0; i < e->func_count; i++)
+        memcpy((char *)&functable + e->offsets[i], &variant->funcs[i], sizeof(functable_func));
+}
+
+static zonce functable_once = ZONCE_INIT;
+
+static void functable_init_once(void) {
+    int i;
+
+    for (i = 0; i < FT_ENTRIES; i++)
+        functable_resolve(i);
+}
+
+/* Chooses all the functions of the process wide functable once. The first stream that is initialized, or else the
+ * first call of a stub, does it for every thread, so that other threads find the functions ready.
+ */
+Z_INTERNAL void functable_init(void) {
+    zonce_run(&functable_once, functable_init_once);
+}
+
+/* stub functions, reached only before functable_init() */
+Z_INTERNAL uint32_t update_hash_stub(deflate_state *const s, uint32_t h, uint32_t val) {
+    functable_init();
+    return functable.update_hash(s, h, val);
+}
+
+Z_INTERNAL void insert_string_stub(deflate_state *const s, uint32_t str, uint32_t count) {
+    functable_init();
+    functable.insert_string(s, str, count);
+}
+
+Z_INTERNAL Pos quick_insert_string_stub(deflate_state *const s, const uint32_t str) {
+    functable_init();
+    return functable.quick_insert_string(s, str);
+}
+
+Z_INTERNAL void slide_hash_stub(deflate_state *s) {
+    functable_init();
+    functable.slide_hash(s);
+}
+
+Z_INTERNAL uint32_t longest_match_stub(deflate_state *const s, Pos cur_match) {
+    functable_init();
+    return functable.longest_match(s, cur_match);
+}
+
+Z_INTERNAL uint32_t longest_match_slow_stub(deflate_state *const s, Pos cur_match) {
+    functable_init();
+    return functable.longest_match_slow(s, cur_match);
+}
+
+Z_INTERNAL uint32_t adler32_stub(uint32_t adler, const uint8_t *buf, uint64_t len) {
+    functable_init();
     return functable.adler32(adler, buf, len);
 }
 
 Z_INTERNAL uint32_t adler32_fold_copy_stub(uint32_t adler, uint8_t *dst, const uint8_t *src, uint64_t len) {
-    functable.adler32_fold_copy = &adler32_fold_copy_c;
-#if (defined X86_SSE42_ADLER32)
-    if (x86_cpu_has_sse42)
-        functable.adler32_fold_copy = &adler32_fold_copy_sse42;
-#endif
-#ifdef X86_AVX2_ADLER32
-    if (x86_cpu_has_avx2)
-        functable.adler32_fold_copy = &adler32_fold_copy_avx2;
-#endif
-#ifdef X86_AVX512_ADLER32
-    if (x86_cpu_has_avx512)
-        functable.adler32_fold_copy = &adler32_fold_copy_avx512;
-#endif
-#ifdef X86_AVX512VNNI_ADLER32
-    if (x86_cpu_has_avx512vnni)
-        functable.adler32_fold_copy = &adler32_fold_copy_avx512_vnni;
-#endif
+    functable_init();
     return functable.adler32_fold_copy(adler, dst, src, len);
 }
 
 Z_INTERNAL uint32_t crc32_fold_reset_stub(crc32_fold *crc) {
-    functable.crc32_fold_reset = &crc32_fold_reset_c;
-    cpu_check_features();
-#ifdef X86_PCLMULQDQ_CRC
-    if (x86_cpu_has_pclmulqdq)
-        functable.crc32_fold_reset = &crc32_fold_pclmulqdq_reset;
-#endif
+    functable_init();
     return functable.crc32_fold_reset(crc);
 }
 
 Z_INTERNAL void crc32_fold_copy_stub(crc32_fold *crc, uint8_t *dst, const uint8_t *src, uint64_t len) {
-    functable.crc32_fold_copy = &crc32_fold_copy_c;
-    cpu_check_features();
-#ifdef X86_PCLMULQDQ_CRC
-    if (x86_cpu_has_pclmulqdq)
-        functable.crc32_fold_copy = &crc32_fold_pclmulqdq_copy;
-#endif
+    functable_init();
     functable.crc32_fold_copy(crc, dst, src, len);
 }
 
 Z_INTERNAL void crc32_fold_stub(crc32_fold *crc, const uint8_t *src, uint64_t len, uint32_t init_crc) {
-    functable.crc32_fold = &crc32_fold_c;
-    cpu_check_features();
-#ifdef X86_PCLMULQDQ_CRC
-    if (x86_cpu_has_pclmulqdq)
-        functable.crc32_fold = &crc32_fold_pclmulqdq;
-#endif
+    functable_init();
     functable.crc32_fold(crc, src, len, init_crc);
 }
 
 Z_INTERNAL uint32_t crc32_fold_final_stub(crc32_fold *crc) {
-    functable.crc32_fold_final = &crc32_fold_final_c;
-    cpu_check_features();
-#ifdef X86_PCLMULQDQ_CRC
-    if (x86_cpu_has_pclmulqdq)
-        functable.crc32_fold_final = &crc32_fold_pclmulqdq_final;
-#endif
+    functable_init();
     return functable.crc32_fold_final(crc);
 }
 
 Z_INTERNAL uint32_t chunksize_stub(void) {
-    // Initialize default
-    functable.chunksize = &chunksize_c;
-    cpu_check_features();
-
-#ifdef X86_SSE2_CHUNKSET
-# if !defined(__x86_64__) && !defined(_M_X64) && !defined(X86_NOCHECK_SSE2)
-    if (x86_cpu_has_sse2)
-# endif
-        functable.chunksize = &chunksize_sse2;
-#endif
-#ifdef X86_AVX_CHUNKSET
-    if (x86_cpu_has_avx2)
-        functable.chunksize = &chunksize_avx;
-#endif
-#ifdef ARM_NEON_CHUNKSET
-    if (arm_cpu_has_neon)
-        functable.chunksize = &chunksize_neon;
-#endif
-#ifdef POWER8_VSX_CHUNKSET
-    if (power_cpu_has_arch_2_07)
-        functable.chunksize = &chunksize_power8;
-#endif
-
+    functable_init();
     return functable.chunksize();
 }
 
 Z_INTERNAL uint8_t* chunkcopy_stub(uint8_t *out, uint8_t const *from, unsigned len) {
-    // Initialize default
-    functable.chunkcopy = &chunkcopy_c;
-
-#ifdef X86_SSE2_CHUNKSET
-# if !defined(__x86_64__) && !defined(_M_X64) && !defined(X86_NOCHECK_SSE2)
-    if (x86_cpu_has_sse2)
-# endif
-        functable.chunkcopy = &chunkcopy_sse2;
-#endif
-#ifdef X86_AVX_CHUNKSET
-    if (x86_cpu_has_avx2)
-        functable.chunkcopy = &chunkcopy_avx;
-#endif
-#ifdef ARM_NEON_CHUNKSET
-    if (arm_cpu_has_neon)
-        functable.chunkcopy = &chunkcopy_neon;
-#endif
-#ifdef POWER8_VSX_CHUNKSET
-    if (power_cpu_has_arch_2_07)
-        functable.chunkcopy = &chunkcopy_power8;
-#endif
-
+    functable_init();
     return functable.chunkcopy(out, from, len);
 }
 
 Z_INTERNAL uint8_t* chunkunroll_stub(uint8_t *out, unsigned *dist, unsigned *len) {
-    // Initialize default
-    functable.chunkunroll = &chunkunroll_c;
-
-#ifdef X86_SSE2_CHUNKSET
-# if !defined(__x86_64__) && !defined(_M_X64) && !defined(X86_NOCHECK_SSE2)
-    if (x86_cpu_has_sse2)
-# endif
-        functable.chunkunroll = &chunkunroll_sse2;
-#endif
-#ifdef X86_AVX_CHUNKSET
-    if (x86_cpu_has_avx2)
-        functable.chunkunroll = &chunkunroll_avx;
-#endif
-#ifdef ARM_NEON_CHUNKSET
-    if (arm_cpu_has_neon)
-        functable.chunkunroll = &chunkunroll_neon;
-#endif
-#ifdef POWER8_VSX_CHUNKSET
-    if (power_cpu_has_arch_2_07)
-        functable.chunkunroll = &chunkunroll_power8;
-#endif
-
+    functable_init();
     return functable.chunkunroll(out, dist, len);
 }
 
 Z_INTERNAL uint8_t* chunkmemset_stub(uint8_t *out, unsigned dist, unsigned len) {
-    // Initialize default
-    functable.chunkmemset = &chunkmemset_c;
-
-#ifdef X86_SSE2_CHUNKSET
-# if !defined(__x86_64__) && !defined(_M_X64) && !defined(X86_NOCHECK_SSE2)
-    if (x86_cpu_has_sse2)
-# endif
-        functable.chunkmemset = &chunkmemset_sse2;
-#endif
-#if defined(X86_SSE41) && defined(X86_SSE2)
-    if (x86_cpu_has_sse41)
-        functable.chunkmemset = &chunkmemset_sse41;
-#endif
-#ifdef X86_AVX_CHUNKSET
-    if (x86_cpu_has_avx2)
-        functable.chunkmemset = &chunkmemset_avx;
-#endif
-#ifdef ARM_NEON_CHUNKSET
-    if (arm_cpu_has_neon)
-        functable.chunkmemset = &chunkmemset_neon;
-#endif
-#ifdef POWER8_VSX_CHUNKSET
-    if (power_cpu_has_arch_2_07)
-        functable.chunkmemset = &chunkmemset_power8;
-#endif
-
-
+    functable_init();
     return functable.chunkmemset(out, dist, len);
 }
 
 Z_INTERNAL uint8_t* chunkmemset_safe_stub(uint8_t *out, unsigned dist, unsigned len, unsigned left) {
-    // Initialize default
-    functable.chunkmemset_safe = &chunkmemset_safe_c;
+    functable_init();
+    return functable.chunkmemset_safe(out, dist, len, left);
+}
 
-#ifdef X86_SSE2_CHUNKSET
-# if !defined(__x86_64__) && !defined(_M_X64) && !defined(X86_NOCHECK_SSE2)
-    if (x86_cpu_has_sse2)
-# endif
-        functable.chunkmemset_safe = &chunkmemset_safe_sse2;
-#endif
-#if defined(X86_SSE41) && defined(X86_SSE2)
-    if (x86_cpu_has_sse41)
-        functable.chunkmemset_safe = &chunkmemset_safe_sse41;
-#endif
-#ifdef X86_AVX_CHUNKSET
-    if (x86_cpu_has_avx2)
-        functable.chunkmemset_safe = &chunkmemset_safe_avx;
-#endif
-#ifdef ARM_NEON_CHUNKSET
-    if (arm_cpu_has_neon)
-        functable.chunkmemset_safe = &chunkmemset_safe_neon;
-#endif
-#ifdef POWER8_VSX_CHUNKSET
-    if (power_cpu_has_arch_2_07)
-        functable.chunkmemset_safe = &chunkmemset_safe_power8;
+Z_INTERNAL block_state deflate_fast_stub(deflate_state *s, int flush) {
+    functable_init();
+    return functable.deflate_fast(s, flush);
+}
+
+#ifndef NO_MEDIUM_STRATEGY
+Z_INTERNAL block_state deflate_medium_stub(deflate_state *s, int flush) {
+    functable_init();
+    return functable.deflate_medium(s, flush);
+}
 #endif
 
-    return functable.chunkmemset_safe(out, dist, len, left);
+Z_INTERNAL block_state deflate_slow_stub(deflate_state *s, int flush) {
+    functable_init();
+    return functable.deflate_slow(s, flush);
+}
+
+Z_INTERNAL void inflate_fast_stub(PREFIX3(stream) *strm, unsigned long start) {
+    functable_init();
+    functable.inflate_fast(strm, start);
 }
 
 Z_INTERNAL uint32_t crc32_stub(uint32_t crc, const uint8_t *buf, uint64_t len) {
     Assert(sizeof(uint64_t) >= sizeof(size_t),
            "crc32_z takes size_t but internally we have a uint64_t len");
 
-    functable.crc32 = &crc32_braid;
-    cpu_check_features();
-#ifdef ARM_ACLE_CRC_HASH
-    if (arm_cpu_has_crc32)
-        functable.crc32 = &crc32_acle;
-#elif defined(POWER8_VSX_CRC32)
-    if (power_cpu_has_arch_2_07)
-        functable.crc32 = &crc32_power8;
-#elif defined(S390_CRC32_VX)
-    if (PREFIX(s390_cpu_has_vx))
-        functable.crc32 = &PREFIX(s390_crc32_vx);
-#elif defined(X86_PCLMULQDQ_CRC)
-    if (x86_cpu_has_pclmulqdq)
-        functable.crc32 = &crc32_pclmulqdq;
-#endif
-
+    functable_init();
     return functable.crc32(crc, buf, len);
 }
 
 Z_INTERNAL uint32_t compare256_stub(const uint8_t *src0, const uint8_t *src1) {
+    functable_init();
+    return functable.compare256(src0, src1);
+}
 
-#ifdef UNALIGNED_OK
-#  if defined(UNALIGNED64_OK) && defined(HAVE_BUILTIN_CTZLL)
-    functable.compare256 = &compare256_unaligned_64;
-#  elif defined(HAVE_BUILTIN_CTZ)
-    functable.compare256 = &compare256_unaligned_32;
-#  else
-    functable.compare256 = &compare256_unaligned_16;
-#  endif
-#else
-    functable.compare256 = &compare256_c;
-#endif
-#if defined(X86_SSE2) && defined(HAVE_BUILTIN_CTZ)
-    if (x86_cpu_has_sse2)
-        functable.compare256 = &compare256_sse2;
-#endif
-#if defined(X86_AVX2) && defined(HAVE_BUILTIN_CTZ)
-    if (x86_cpu_has_avx2)
-        functable.compare256 = &compare256_avx2;
-#endif
-#ifdef POWER9
-    if (power_cpu_has_arch_3_00)
-        functable.compare256 = &compare256_power9;
-#endif
+#ifdef WITH_IFUNC
+/* GNU IFUNC resolvers for the exported checksum functions, run while the dynamic linker relocates zlib-ng. The
+ * environment and the relocated variant tables are not usable yet, so they only detect the CPU features and pick
+ * the most preferred variant from the lists above, and neither ZLIBNG_CPU nor zng_functable_select() applies to them.
+ */
+#define IFUNC_VARIANT(name, cpu_has, f) \
+    if (ifunc_available(cpu_has)) \
+        func = &f;
 
-    return functable.compare256(src0, src1);
+static int ifunc_available(const int *cpu_has) {
+    return cpu_has == NULL || *cpu_has;
 }
 
+Z_INTERNAL adler32_func adler32_resolve(void) {
+    adler32_func func = NULL;
+
+    cpu_detect_features();
+    ADLER32_VARIANTS(IFUNC_VARIANT)
+    return func;
+}
+
+Z_INTERNAL crc32_func crc32_resolve(void) {
+    crc32_func func = NULL;
+
+    cpu_detect_features();
+    CRC32_VARIANTS(IFUNC_VARIANT)
+    return func;
+}
+
+Z_INTERNAL uint32_t adler32_ifunc(uint32_t adler, const uint8_t *buf, uint64_t len)
+    __attribute__((ifunc("adler32_resolve")));
+Z_INTERNAL uint32_t crc32_ifunc(uint32_t crc, const uint8_t *buf, uint64_t len)
+    __attribute__((ifunc("crc32_resolve")));
+#endif
+
 /* functable init */
-Z_INTERNAL Z_TLS struct functable_s functable = {
+Z_INTERNAL struct functable_s functable = {
     adler32_stub,
     adler32_fold_copy_stub,
     crc32_stub,
@@ -470,6 +476,12 @@ Z_INTERNAL Z_TLS struct functable_s functable = {
     chunkunroll_stub,
     chunkmemset_stub,
     chunkmemset_safe_stub,
+    deflate_fast_stub,
+#ifndef NO_MEDIUM_STRATEGY
+    deflate_medium_stub,
+#endif
+    deflate_slow_stub,
+    inflate_fast_stub,
     insert_string_stub,
     longest_match_stub,
     longest_match_slow_stub,
@@ -477,3 +489,75 @@ Z_INTERNAL Z_TLS struct functable_s functable = {
     slide_hash_stub,
     update_hash_stub
 };
+
+#ifndef ZLIB_COMPAT
+
+static int functable_find(const char *entry) {
+    int i;
+
+    if (entry == NULL)
+        return -1;
+    for (i = 0; i < FT_ENTRIES; i++) {
+        if (strcmp(functable_entries[i].name, entry) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int32_t Z_EXPORT zng_set_cpu_features(const char *features) {
+    int i;
+
+    functable_init();
+    if (cpu_set_features(features) != 0)
+        return Z_STREAM_ERROR;
+    for (i = 0; i < FT_ENTRIES; i++)
+        functable_resolve(i);
+    return Z_OK;
+}
+
+const char * Z_EXPORT zng_functable_entry(int32_t index) {
+    if (index < 0 || index >= FT_ENTRIES)
+        return NULL;
+    return functable_entries[index].name;
+}
+
+const char * Z_EXPORT zng_functable_variant(const char *entry, int32_t index) {
+    int i, e = functable_find(entry);
+
+    if (e < 0 || index < 0)
+        return NULL;
+    functable_init();
+    functable_check_features();
+    for (i = functable_entries[e].variant_count - 1; i >= 0; i--) {
+        const functable_variant *variant = &functable_entries[e].variants[i];
+        if (functable_available(variant) && index-- == 0)
+            return variant->name;
+    }
+    return NULL;
+}
+
+int32_t Z_EXPORT zng_functable_select(const char *entry, const char *variant) {
+    int i, e = functable_find(entry);
+
+    if (e < 0)
+        return Z_STREAM_ERROR;
+    if (variant == NULL) {
+        functable_selected[e] = 0;
+    } else {
+        functable_init();
+        functable_check_features();
+        for (i = 0; i < functable_entries[e].variant_count; i++) {
+            if (strcmp(functable_entries[e].variants[i].name, variant) == 0)
+                break;
+        }
+        if (i == functable_entries[e].variant_count || !functable_available(&functable_entries[e].variants[i]))
+            return Z_STREAM_ERROR;
+        functable_selected[e] = i + 1;
+    }
+    functable_init();
+    /* Resolve all the entries again, since others can depend on this one */
+    for (i = 0; i < FT_ENTRIES; i++)
+        functable_resolve(i);
+    return Z_OK;
+}
+#endif
@@ -24,6 +24,12 @@ struct functable_s {
     uint8_t* (* chunkunroll)        (uint8_t *out, unsigned *dist, unsigned *len);
     uint8_t* (* chunkmemset)        (uint8_t *out, unsigned dist, unsigned len);
     uint8_t* (* chunkmemset_safe)   (uint8_t *out, unsigned dist, unsigned len, unsigned left);
+    block_state (* deflate_fast)    (deflate_state *s, int flush);
+#ifndef NO_MEDIUM_STRATEGY
+    block_state (* deflate_medium)  (deflate_state *s, int flush);
+#endif
+    block_state (* deflate_slow)    (deflate_state *s, int flush);
+    void     (* inflate_fast)       (PREFIX3(stream) *strm, unsigned long start);
     void     (* insert_string)      (deflate_state *const s, uint32_t str, uint32_t count);
     uint32_t (* longest_match)      (deflate_state *const s, Pos cur_match);
     uint32_t (* longest_match_slow) (deflate_state *const s, Pos cur_match);
@@ -32,6 +38,18 @@ struct functable_s {
     uint32_t (* update_hash)        (deflate_state *const s, uint32_t h, uint32_t val);
 };
 
-Z_INTERNAL extern Z_TLS struct functable_s functable;
+Z_INTERNAL extern struct functable_s functable;
+
+void Z_INTERNAL functable_init(void);
+
+/* The exported checksum functions call FUNCTABLE_EXPORT(adler32) and FUNCTABLE_EXPORT(crc32), which WITH_IFUNC binds
+   to the best implementation when zlib-ng is loaded, instead of going through the functable on every call. */
+#ifdef WITH_IFUNC
+uint32_t Z_INTERNAL adler32_ifunc(uint32_t adler, const uint8_t *buf, uint64_t len);
+uint32_t Z_INTERNAL crc32_ifunc(uint32_t crc, const uint8_t *buf, uint64_t len);
+#  define FUNCTABLE_EXPORT(name) name##_ifunc
+#else
+#  define FUNCTABLE_EXPORT(name) functable.name
+#endif
 
 #endif
@@ -34,6 +34,8 @@
 #  include "zlib-ng.h"
 #endif
 
+#include "inflate_index.h"
+
 #ifdef _WIN32
 #  include <stddef.h>
 #endif
@@ -87,6 +89,12 @@
 #  define GZBUFSIZE 131072
 #endif
 
+/* BGZF, the blocked gzip format of the SAM/BAM specification */
+#define BGZF_BLOCK 65280    /* uncompressed bytes per block when writing, so that the block fits in BGZF_MAX if stored */
+#define BGZF_MAX 65536      /* maximum size of a block, including the header and trailer, and of its data */
+#define BGZF_HEADER 18      /* gzip header with the "BC" extra subfield giving the block size */
+#define BGZF_TRAILER 8
+
 /* gzip modes, also provide a little integrity check on the passed structure */
 #define GZ_NONE 0
 #define GZ_READ 7247
@@ -97,6 +105,7 @@
 #define LOOK 0      /* look for a gzip header */
 #define COPY 1      /* copy input directly */
 #define GZIP 2      /* decompress a gzip stream */
+#define MEMBERS 3   /* hand out BGZF members or index spans decompressed in the background */
 
 /* internal gzip file state data structure */
 typedef struct {
@@ -114,15 +123,39 @@ typedef struct {
     unsigned char *in;      /* input buffer (double-sized when writing) */
     unsigned char *out;     /* output buffer (double-sized when reading) */
     int direct;             /* 0 if processing gzip, 1 if transparent */
+    int threads;            /* background threads requested for compressing, or for decompressing BGZF members or index spans */
         /* just for reading */
     int how;                /* 0: get header, 1: copy, 2: decompress */
     z_off64_t start;        /* where the gzip data started, for rewinding */
     int eof;                /* true if end of input file reached */
     int past;               /* true if read requested past end */
+    inflate_index *index;   /* access point index for seeking, or NULL */
+    int indexing;           /* true if index is extended while decompressing */
+    unsigned trailer;       /* gzip trailer bytes to skip after resuming at an access point */
+    int check;              /* true if that trailer is checked, for a member decompressed in index spans from its start */
+    uint32_t crc;           /* CRC-32 of that member up to the output handed out */
+    z_off64_t member;       /* uncompressed offset of the start of that member */
+    int readahead;          /* readahead buffers requested, 0 for none */
+    struct gz_ra_s *ra;     /* readahead, or NULL if reading in gz_load() */
+    int mapped;             /* true if mapping the file into memory was requested with "m" */
+    unsigned char *map;     /* the file mapped into memory, or NULL if reading it */
+    z_off64_t map_len;      /* length of the mapping */
+    z_off64_t map_next;     /* offset in the mapping of the next input */
+    struct gz_mpool_s *mpool; /* decompression of BGZF members or index spans in the background, or NULL */
         /* just for writing */
     int level;              /* compression level */
     int strategy;           /* compression strategy */
     int reset;              /* true if a reset is pending after a Z_FINISH */
+    struct gz_pool_s *pool; /* background compression, or NULL if compressing in gz_comp() */
+    int bgzf;               /* true if writing BGZF blocks, "B" in the mode */
+    unsigned char *block;   /* BGZF block being filled when compressing in gz_comp() */
+    unsigned block_len;     /* bytes in block */
+    z_off64_t block_in;     /* uncompressed and compressed offsets after the last BGZF block written */
+    z_off64_t block_out;
+    char *gzi;              /* path of the .gzi index to write when closing, or NULL */
+    uint64_t *gzi_list;     /* compressed and uncompressed offsets of the BGZF blocks after the first */
+    size_t gzi_have;        /* number of offset pairs in gzi_list */
+    size_t gzi_size;        /* number of offset pairs allocated */
         /* seek request */
     z_off64_t skip;         /* amount to skip (already rewound if backwards) */
     int seek;               /* true if seek request pending */
@@ -136,6 +169,13 @@ typedef gz_state *gz_statep;
 
 /* shared functions */
 void Z_INTERNAL gz_error(gz_state *, int, const char *);
+z_off64_t Z_INTERNAL gz_lseek(gz_state *, z_off64_t, int);
+int Z_INTERNAL gz_index_resume(gz_state *, const inflate_point *);
+#ifdef WITH_THREADS
+z_off64_t Z_INTERNAL gz_readahead_seek(gz_state *, z_off64_t, int);
+void Z_INTERNAL gz_mpool_reset(gz_state *);
+int Z_INTERNAL gz_mpool_spans(gz_state *, const inflate_point *);
+#endif
 
 /* GT_OFF(x), where x is an unsigned value, is true if x > maximum z_off64_t
    value -- needed when comparing unsigned to z_off64_t, which is signed
@@ -20,6 +20,7 @@
 /* Local functions */
 static void gz_reset(gz_state *);
 static gzFile gz_open(const void *, int, const char *);
+static int gz_index_seek(gz_state *, z_off64_t);
 
 /* Reset gzip file state */
 static void gz_reset(gz_state *state) {
@@ -28,6 +29,17 @@ static void gz_reset(gz_state *state) {
         state->eof = 0;             /* not at end of file */
         state->past = 0;            /* have not read past end yet */
         state->how = LOOK;          /* look for gzip header */
+        state->trailer = 0;         /* no gzip trailer to skip */
+        state->check = 0;
+#ifdef WITH_THREADS
+        if (state->mpool != NULL)   /* drop the members being decompressed */
+            gz_mpool_reset(state);
+#endif
+        if (state->index != NULL) { /* extend the index from the start */
+            state->index->in = 0;
+            state->index->out = 0;
+            state->indexing = 1;
+        }
     }
     else                            /* for writing ... */
         state->reset = 0;           /* no deflateReset pending */
@@ -37,6 +49,26 @@ static void gz_reset(gz_state *state) {
     state->strm.avail_in = 0;       /* no input data yet */
 }
 
+/* Set the file position like lseek() does, or the position in the mapping or of the readahead if reading from one
+   of those. Returns the new position, or -1 on error. */
+z_off64_t Z_INTERNAL gz_lseek(gz_state *state, z_off64_t offset, int whence) {
+    if (state->map != NULL) {
+        if (whence == SEEK_CUR)
+            offset += state->map_next;
+        else if (whence != SEEK_SET)
+            return -1;
+        if (offset < 0)
+            return -1;
+        state->map_next = offset;
+        return offset;
+    }
+#ifdef WITH_THREADS
+    if (state->ra != NULL)
+        return gz_readahead_seek(state, offset, whence);
+#endif
+    return LSEEK(state->fd, offset, whence);
+}
+
 /* Open a gzip file either by name or file descriptor. */
 static gzFile gz_open(const void *path, int fd, const char *mode) {
     gz_state *state;
@@ -60,6 +92,24 @@ static gzFile gz_open(const void *path, int fd, const char *mode) {
     state->size = 0;            /* no buffers allocated yet */
     state->want = GZBUFSIZE;    /* requested buffer size */
     state->msg = NULL;          /* no error message yet */
+    state->index = NULL;        /* no access point index */
+    state->indexing = 0;
+    state->threads = 0;         /* compress or decompress on the calling thread */
+    state->pool = NULL;
+    state->mpool = NULL;
+    state->bgzf = 0;            /* write a single gzip stream */
+    state->block = NULL;
+    state->block_len = 0;
+    state->block_in = 0;
+    state->block_out = 0;
+    state->gzi = NULL;
+    state->gzi_list = NULL;
+    state->gzi_have = 0;
+    state->gzi_size = 0;
+    state->readahead = 0;       /* read on the calling thread */
+    state->ra = NULL;
+    state->mapped = 0;          /* read the file, don't map it */
+    state->map = NULL;
 
     /* interpret mode */
     state->mode = GZ_NONE;
@@ -112,6 +162,14 @@ static gzFile gz_open(const void *path, int fd, const char *mode) {
             case 'T':
                 state->direct = 1;
                 break;
+            case 'B':
+                state->bgzf = 1;
+                break;
+#ifdef HAVE_SYS_MMAN_H
+            case 'm':
+                state->mapped = 1;
+                break;
+#endif
             default:        /* could consider as an error, but just ignore */
                 {}
             }
@@ -294,7 +352,7 @@ int Z_EXPORT PREFIX(gzrewind)(gzFile file) {
         return -1;
 
     /* back up and start over */
-    if (LSEEK(state->fd, state->start, SEEK_SET) == -1)
+    if (gz_lseek(state, state->start, SEEK_SET) == -1)
         return -1;
     gz_reset(state);
     return 0;
@@ -330,7 +388,7 @@ z_off64_t Z_EXPORT PREFIX4(gzseek)(gzFile file, z_off64_t offset, int whence) {
 
     /* if within raw area while reading, just go there */
     if (state->mode == GZ_READ && state->how == COPY && state->x.pos + offset >= 0) {
-        ret = LSEEK(state->fd, offset - (z_off64_t)state->x.have, SEEK_CUR);
+        ret = gz_lseek(state, offset - (z_off64_t)state->x.have, SEEK_CUR);
         if (ret == -1)
             return -1;
         state->x.have = 0;
@@ -343,6 +401,14 @@ z_off64_t Z_EXPORT PREFIX4(gzseek)(gzFile file, z_off64_t offset, int whence) {
         return state->x.pos;
     }
 
+    /* if reading with an index, resume at the closest access point instead */
+    if (state->mode == GZ_READ && state->index != NULL && state->x.pos + offset >= 0) {
+        ret = state->x.pos + offset;
+        if (gz_index_seek(state, ret) == -1)
+            return -1;
+        offset = ret - state->x.pos;
+    }
+
     /* calculate skip amount, rewinding if needed for back seek when reading */
     if (offset < 0) {
         if (state->mode != GZ_READ)         /* writing -- can't go backwards */
@@ -371,6 +437,198 @@ z_off64_t Z_EXPORT PREFIX4(gzseek)(gzFile file, z_off64_t offset, int whence) {
     return state->x.pos + offset;
 }
 
+/* Resume decompression in the calling thread at an access point of the index,
+   which can be a copy of one.  inflate is set up to decode the deflate data raw
+   from there, gz_look() skips the gzip trailer at its end, and the index is
+   extended beyond its last access point.  Return -1 on error, 0 otherwise. */
+int Z_INTERNAL gz_index_resume(gz_state *state, const inflate_point *point) {
+    int ret;
+
+    if (gz_lseek(state, state->start + point->in, SEEK_SET) == -1)
+        return -1;
+    ret = inflate_index_resume(&state->strm, point);
+    if (ret != Z_OK) {
+        if (ret == Z_MEM_ERROR)
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+        else
+            gz_error(state, Z_STREAM_ERROR, "internal error: inflate stream corrupt");
+        return -1;
+    }
+    state->how = GZIP;
+    state->trailer = 8;
+    state->eof = 0;
+    state->strm.avail_in = 0;
+    state->x.pos = point->out;
+    state->index->in = point->in;
+    state->index->out = point->out;
+    state->indexing = 1;
+    return 0;
+}
+
+/* Resume decompression at the last access point in the index at or before
+   the uncompressed offset, if that avoids decompressing data to get there --
+   that is for any seek backwards, and for a seek forwards to past an access
+   point that is beyond the data in the output buffer.  With threads, the
+   spans between the access points from there on are decompressed in the
+   background.  Return -1 on error, 0 otherwise. */
+static int gz_index_seek(gz_state *state, z_off64_t offset) {
+    const inflate_point *point;
+    int direct;
+
+    /* only gzip streams can be indexed -- this looks for the header if needed */
+    direct = PREFIX(gzdirect)((gzFile)state);
+    if (state->err != Z_OK && state->err != Z_BUF_ERROR)
+        return -1;
+    if (direct)
+        return 0;
+
+    point = inflate_index_find(state->index, offset);
+    if (point == NULL || (offset >= state->x.pos && point->out <= state->x.pos + (z_off64_t)state->x.have))
+        return 0;
+
+#ifdef WITH_THREADS
+    if (state->mpool != NULL)
+        gz_mpool_reset(state);
+#endif
+    state->x.have = 0;
+    state->past = 0;
+    state->check = 0;
+    gz_error(state, Z_OK, NULL);
+#ifdef WITH_THREADS
+    if (state->threads)
+        return gz_mpool_spans(state, point);
+#endif
+    return gz_index_resume(state, point);
+}
+
+#ifndef ZLIB_COMPAT
+/* Replace the index of state.  The index can be extended while decompressing
+   right away only if nothing has been read yet, otherwise that starts after
+   the next rewind or jump to an access point. */
+static void gz_index_set(gz_state *state, inflate_index *index) {
+    inflate_index_end(state->index);
+    state->index = index;
+    state->indexing = state->size == 0;
+}
+
+/* -- see zlib-ng.h -- */
+int32_t Z_EXPORT zng_gzindex(gzFile file, z_off64_t span) {
+    inflate_index *index;
+    gz_state *state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_state *)file;
+    if (state->mode != GZ_READ || span <= 0)
+        return -1;
+
+    if (inflate_index_init(&index, span) != Z_OK)
+        return -1;
+    gz_index_set(state, index);
+    return 0;
+}
+
+/* -- see zlib-ng.h -- */
+int32_t Z_EXPORT zng_gzindexload(gzFile file, const char *path) {
+    inflate_index *index;
+    unsigned char *buf, *more;
+    size_t len, size;
+    gz_state *state;
+    FILE *in;
+    int ret;
+
+    /* get internal structure and check integrity */
+    if (file == NULL || path == NULL)
+        return -1;
+    state = (gz_state *)file;
+    if (state->mode != GZ_READ)
+        return -1;
+
+    /* read the whole index file */
+    in = fopen(path, "rb");
+    if (in == NULL)
+        return -1;
+    len = 0;
+    size = 65536;
+    buf = (unsigned char *)malloc(size);
+    while (buf != NULL) {
+        len += fread(buf + len, 1, size - len, in);
+        if (len < size)
+            break;
+        more = (unsigned char *)realloc(buf, size << 1);
+        if (more == NULL)
+            free(buf);
+        buf = more;
+        size <<= 1;
+    }
+    ret = buf == NULL || ferror(in) ? -1 : 0;
+    fclose(in);
+
+    if (ret == 0 && inflate_index_load(&index, buf, len) == Z_OK)
+        gz_index_set(state, index);
+    else
+        ret = -1;
+    free(buf);
+    return ret;
+}
+
+/* -- see zlib-ng.h -- */
+int32_t Z_EXPORT zng_gzindexsave(gzFile file, const char *path) {
+    unsigned char *buf;
+    gz_state *state;
+    size_t len;
+    FILE *out;
+    int ret;
+
+    /* get internal structure and check integrity */
+    if (file == NULL || path == NULL)
+        return -1;
+    state = (gz_state *)file;
+    if (state->mode != GZ_READ || state->index == NULL)
+        return -1;
+
+    /* serialize the index and write it out */
+    inflate_index_save(state->index, NULL, &len);
+    buf = (unsigned char *)malloc(len);
+    if (buf == NULL)
+        return -1;
+    inflate_index_save(state->index, buf, &len);
+    out = fopen(path, "wb");
+    if (out == NULL) {
+        free(buf);
+        return -1;
+    }
+    ret = fwrite(buf, 1, len, out) == len ? 0 : -1;
+    if (fclose(out))
+        ret = -1;
+    free(buf);
+    return ret;
+}
+
+/* -- see zlib-ng.h -- */
+int32_t Z_EXPORT zng_gzsetthreads(gzFile file, int32_t threads) {
+    gz_state *state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_state *)file;
+    if (state->mode != GZ_READ && state->mode != GZ_WRITE)
+        return -1;
+
+    /* make sure we haven't already allocated memory */
+    if (state->size != 0 || threads < 0)
+        return -1;
+#ifndef WITH_THREADS
+    if (threads)
+        return -1;
+#endif
+    state->threads = threads;
+    return 0;
+}
+#endif
+
 /* -- see zlib.h -- */
 #ifdef ZLIB_COMPAT
 z_off_t Z_EXPORT PREFIX(gzseek)(gzFile file, z_off_t offset, int whence) {
@@ -420,7 +678,7 @@ z_off64_t Z_EXPORT PREFIX4(gzoffset)(gzFile file) {
         return -1;
 
     /* compute and return effective offset in file */
-    offset = LSEEK(state->fd, 0, SEEK_CUR);
+    offset = gz_lseek(state, 0, SEEK_CUR);
     if (offset == -1)
         return -1;
     if (state->mode == GZ_READ)             /* reading */
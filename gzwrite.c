@@ -4,7 +4,9 @@
  */
 
 #include "zbuild.h"
+#include "zutil.h"
 #include "zutil_p.h"
+#include "zthread.h"
 #include <stdarg.h>
 #include "gzguts.h"
 
@@ -14,6 +16,600 @@ static int gz_comp(gz_state *, int);
 static int gz_zero(gz_state *, z_off64_t);
 static size_t gz_write(gz_state *, void const *, size_t);
 
+/* BGZF, the blocked gzip format of the SAM/BAM specification, written for "B" in the gzopen() mode. The input is
+   cut into blocks of at most BGZF_BLOCK bytes, each compressed as a separate gzip member with an extra field that
+   gives its compressed size, so that a reader can find the members, and seek or decompress them in parallel,
+   without decompressing what comes before. An empty member marks the end of the file. */
+
+/* empty block at the end of a BGZF file */
+static const unsigned char bgzf_eof[28] = {
+    31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 66, 67, 2, 0, 27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/* Compress len bytes from in into a BGZF block at out, which has room for BGZF_MAX bytes, using the raw deflate
+   stream strm. If the compressed data does not fit, the data is stored instead. Return the size of the block, or 0
+   on a deflate error. */
+static unsigned gz_bgzf_deflate(PREFIX3(stream) *strm, const unsigned char *in, unsigned len, unsigned char *out,
+                                int level, int strategy) {
+    unsigned size;
+    uint32_t crc;
+    int ret;
+
+    for (;;) {
+        ret = PREFIX(deflateReset)(strm);
+        if (ret == Z_OK)
+            ret = PREFIX(deflateParams)(strm, level, strategy);
+        if (ret != Z_OK)
+            return 0;
+        strm->next_in = (z_const unsigned char *)in;
+        strm->avail_in = len;
+        strm->next_out = out + BGZF_HEADER;
+        strm->avail_out = BGZF_MAX - BGZF_HEADER - BGZF_TRAILER;
+        ret = PREFIX(deflate)(strm, Z_FINISH);
+        if (ret == Z_STREAM_END)
+            break;
+        if (ret == Z_STREAM_ERROR || level == 0)
+            return 0;
+        level = 0;
+        strategy = Z_DEFAULT_STRATEGY;
+    }
+    size = BGZF_MAX - BGZF_TRAILER - strm->avail_out;
+
+    out[0] = 31;
+    out[1] = 139;
+    out[2] = 8;         /* deflate with an extra field, no modification time */
+    out[3] = 4;
+    memset(out + 4, 0, 5);
+    out[9] = 255;       /* unknown operating system */
+    out[10] = 6;        /* extra field length */
+    out[11] = 0;
+    out[12] = 'B';      /* subfield with the block size minus one */
+    out[13] = 'C';
+    out[14] = 2;
+    out[15] = 0;
+    out[16] = (unsigned char)(size + BGZF_TRAILER - 1);
+    out[17] = (unsigned char)((size + BGZF_TRAILER - 1) >> 8);
+    crc = PREFIX(crc32)(0, in, len);
+    out[size] = (unsigned char)crc;
+    out[size + 1] = (unsigned char)(crc >> 8);
+    out[size + 2] = (unsigned char)(crc >> 16);
+    out[size + 3] = (unsigned char)(crc >> 24);
+    out[size + 4] = (unsigned char)len;
+    out[size + 5] = (unsigned char)(len >> 8);
+    out[size + 6] = 0;
+    out[size + 7] = 0;
+    return size + BGZF_TRAILER;
+}
+
+/* Account for a BGZF block of size bytes holding len bytes of data, adding where it starts to the index if one will
+   be written and it is not the first block. Return -1 on a memory allocation failure, or 0 otherwise. */
+static int gz_bgzf_mark(gz_state *state, unsigned size, unsigned len) {
+    uint64_t *list;
+    int first = state->block_out == 0;
+
+    state->block_out += size;
+    state->block_in += len;
+    if (state->gzi == NULL || first)
+        return 0;
+    if (state->gzi_have == state->gzi_size) {
+        list = (uint64_t *)realloc(state->gzi_list, 2 * sizeof(uint64_t) * (state->gzi_size ? 2 * state->gzi_size : 64));
+        if (list == NULL)
+            return -1;
+        state->gzi_list = list;
+        state->gzi_size = state->gzi_size ? 2 * state->gzi_size : 64;
+    }
+    state->gzi_list[2 * state->gzi_have] = (uint64_t)(state->block_out - size);
+    state->gzi_list[2 * state->gzi_have + 1] = (uint64_t)(state->block_in - len);
+    state->gzi_have++;
+    return 0;
+}
+
+/* Write the .gzi index, the number of entries followed by the compressed and uncompressed offset of each block
+   after the first, all as little-endian 64-bit integers. Return -1 on error, or 0 otherwise. */
+static int gz_bgzf_index(gz_state *state) {
+    unsigned char buf[8];
+    uint64_t val;
+    size_t i, n;
+    FILE *out;
+    int k, ret = 0;
+
+    out = fopen(state->gzi, "wb");
+    if (out == NULL)
+        return -1;
+    for (i = 0; i < 2 * state->gzi_have + 1 && ret == 0; i++) {
+        val = i ? state->gzi_list[i - 1] : (uint64_t)state->gzi_have;
+        for (k = 0; k < 8; k++)
+            buf[k] = (unsigned char)(val >> (8 * k));
+        n = fwrite(buf, 1, 8, out);
+        if (n != 8)
+            ret = -1;
+    }
+    if (fclose(out) == EOF)
+        ret = -1;
+    return ret;
+}
+
+/* Compress len bytes from buf into a BGZF block and write it. Return -1 on error, or 0 otherwise. */
+static int gz_bgzf_write(gz_state *state, const unsigned char *buf, unsigned len) {
+    PREFIX3(stream) *strm = &(state->strm);
+    z_const unsigned char *next = strm->next_in;
+    unsigned avail = strm->avail_in, size;
+    ssize_t got;
+
+    /* the stream input refers to the data being compressed by gz_comp(), keep it */
+    size = gz_bgzf_deflate(strm, buf, len, state->out, state->level, state->strategy);
+    strm->next_in = next;
+    strm->avail_in = avail;
+    if (size == 0) {
+        gz_error(state, Z_STREAM_ERROR, "internal error: deflate stream corrupt");
+        return -1;
+    }
+    got = write(state->fd, state->out, size);
+    if (got < 0 || (unsigned)got != size) {
+        gz_error(state, Z_ERRNO, zstrerror());
+        return -1;
+    }
+    if (gz_bgzf_mark(state, size, len) == -1) {
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+    return 0;
+}
+
+/* gz_comp() for BGZF. Whole blocks are compressed straight from the input, the rest is collected in state->block
+   until it is full or a flush is requested. */
+static int gz_comp_bgzf(gz_state *state, int flush) {
+    PREFIX3(stream) *strm = &(state->strm);
+    unsigned copy;
+
+    while (strm->avail_in) {
+        if (state->block_len == 0 && strm->avail_in >= BGZF_BLOCK) {
+            copy = BGZF_BLOCK;
+            if (gz_bgzf_write(state, strm->next_in, copy) == -1)
+                return -1;
+        } else {
+            copy = MIN(BGZF_BLOCK - state->block_len, strm->avail_in);
+            memcpy(state->block + state->block_len, strm->next_in, copy);
+            state->block_len += copy;
+        }
+        strm->next_in += copy;
+        strm->avail_in -= copy;
+        if (state->block_len == BGZF_BLOCK) {
+            if (gz_bgzf_write(state, state->block, BGZF_BLOCK) == -1)
+                return -1;
+            state->block_len = 0;
+        }
+    }
+
+    /* every block is a complete gzip member, so all flushes just end the block being filled */
+    if (flush != Z_NO_FLUSH && state->block_len) {
+        if (gz_bgzf_write(state, state->block, state->block_len) == -1)
+            return -1;
+        state->block_len = 0;
+    }
+    return 0;
+}
+
+#ifdef WITH_THREADS
+/* Background compression for zng_gzsetthreads(). The input is cut into chunks of state->size bytes, which worker
+   threads compress as raw deflate data, each primed with the last 32K of the chunk before it and ended with a sync
+   flush, so that the compressed chunks concatenate into a single deflate stream. A writer thread writes them to the
+   file in order, wrapped in a gzip header and trailer. The jobs are used as a ring in the order of the input, the
+   application fills one while the others are compressed or written. When writing BGZF, the chunks are the blocks,
+   that the workers compress into complete gzip members without a dictionary. */
+
+#include <errno.h>
+
+#define GZ_DICT 32768       /* dictionary taken from the previous chunk */
+
+/* job status */
+#define GZ_JOB_FREE 0       /* can be filled by the application */
+#define GZ_JOB_READY 1      /* waiting to be compressed */
+#define GZ_JOB_BUSY 2       /* being compressed */
+#define GZ_JOB_DONE 3       /* waiting to be written */
+
+typedef struct gz_job_s {
+    int status;             /* see job status above */
+    unsigned char *in;      /* dictionary followed by the chunk */
+    unsigned dict;          /* length of the dictionary */
+    unsigned len;           /* length of the chunk */
+    unsigned char *out;     /* compressed chunk */
+    unsigned have;          /* length of the compressed chunk */
+    uint32_t crc;           /* crc-32 of the chunk */
+    int level;              /* compression parameters for the chunk */
+    int strategy;
+    int first;              /* true if the chunk starts a gzip member */
+    int last;               /* true if the chunk ends a gzip member */
+} gz_job;
+
+typedef struct gz_pool_s {
+    zmutex lock;
+    zcond cond;             /* signalled on every change of the job status */
+    gz_state *state;
+    gz_job *jobs;
+    unsigned count;         /* number of jobs */
+    unsigned size;          /* most bytes in a chunk */
+    unsigned out_size;      /* size of each compressed chunk buffer */
+    unsigned fill;          /* next job to hand to the workers */
+    unsigned comp;          /* next job to compress */
+    unsigned done;          /* next job to write */
+    unsigned pending;       /* jobs handed to the workers that are not written yet */
+    gz_job *job;            /* job being filled, or NULL */
+    int member;             /* true if a gzip member was started and not finished */
+    int fresh;              /* true if the next chunk must not refer to earlier ones */
+    PREFIX3(stream) *strms; /* one raw deflate stream per worker */
+    int32_t strm_count;     /* number of initialized streams */
+    int32_t next;           /* next stream to take by a worker */
+    zthread *workers;
+    int32_t threads;        /* number of workers started */
+    zthread writer;
+    int quit;               /* true if the threads should exit */
+    int err;                /* Z_OK, Z_ERRNO for a write error, Z_STREAM_ERROR for a deflate error, or Z_MEM_ERROR */
+    int errnum;             /* errno of a write error */
+    uint32_t crc;           /* crc-32 and length of the gzip member being written */
+    uint32_t isize;
+} gz_pool;
+
+/* Compress a chunk, return Z_OK on success */
+static int gz_pool_deflate(PREFIX3(stream) *strm, gz_job *job, unsigned out_size) {
+    int ret;
+
+    ret = PREFIX(deflateReset)(strm);
+    if (ret == Z_OK)
+        ret = PREFIX(deflateParams)(strm, job->level, job->strategy);
+    if (ret == Z_OK && job->dict)
+        ret = PREFIX(deflateSetDictionary)(strm, job->in, job->dict);
+    if (ret != Z_OK)
+        return ret;
+
+    strm->next_in = job->in + job->dict;
+    strm->avail_in = job->len;
+    strm->next_out = job->out;
+    strm->avail_out = out_size;
+    ret = PREFIX(deflate)(strm, job->last ? Z_FINISH : Z_SYNC_FLUSH);
+    job->have = out_size - strm->avail_out;
+    job->crc = PREFIX(crc32)(0, job->in + job->dict, job->len);
+    if (job->last)
+        return ret == Z_STREAM_END ? Z_OK : Z_BUF_ERROR;
+    return ret == Z_OK && strm->avail_in == 0 && strm->avail_out ? Z_OK : Z_BUF_ERROR;
+}
+
+static void gz_pool_worker(void *arg) {
+    gz_pool *pool = (gz_pool *)arg;
+    PREFIX3(stream) *strm;
+    gz_job *job;
+    int ret;
+
+    zmutex_lock(&pool->lock);
+    strm = &pool->strms[pool->next++];
+    for (;;) {
+        while (!pool->quit && pool->jobs[pool->comp].status != GZ_JOB_READY)
+            zcond_wait(&pool->cond, &pool->lock);
+        if (pool->quit)
+            break;
+        job = &pool->jobs[pool->comp];
+        job->status = GZ_JOB_BUSY;
+        pool->comp = (pool->comp + 1) % pool->count;
+        zmutex_unlock(&pool->lock);
+
+        if (pool->state->bgzf) {
+            job->have = gz_bgzf_deflate(strm, job->in, job->len, job->out, job->level, job->strategy);
+            ret = job->have ? Z_OK : Z_STREAM_ERROR;
+        } else {
+            ret = gz_pool_deflate(strm, job, pool->out_size);
+        }
+
+        zmutex_lock(&pool->lock);
+        if (ret != Z_OK && pool->err == Z_OK)
+            pool->err = Z_STREAM_ERROR;
+        job->status = GZ_JOB_DONE;
+        zcond_broadcast(&pool->cond);
+    }
+    zmutex_unlock(&pool->lock);
+}
+
+/* Write len bytes from buf to the file, return -1 on error */
+static int gz_pool_put(gz_state *state, const unsigned char *buf, unsigned len) {
+    ssize_t got;
+
+    if (len == 0)
+        return 0;
+    got = write(state->fd, buf, len);
+    return got < 0 || (unsigned)got != len ? -1 : 0;
+}
+
+/* Write a compressed chunk, with the gzip header before it or the gzip trailer after it if needed. Return Z_ERRNO on
+   a write error, Z_MEM_ERROR if the BGZF index could not grow, or Z_OK otherwise. */
+static int gz_pool_write(gz_pool *pool, gz_job *job) {
+    unsigned char buf[10];
+
+    if (pool->state->bgzf) {
+        if (gz_pool_put(pool->state, job->out, job->have) == -1)
+            return Z_ERRNO;
+        return gz_bgzf_mark(pool->state, job->have, job->len) == -1 ? Z_MEM_ERROR : Z_OK;
+    }
+    if (job->first) {
+        buf[0] = 31;
+        buf[1] = 139;
+        buf[2] = 8;     /* deflate, no flags and no modification time */
+        memset(buf + 3, 0, 5);
+        buf[8] = job->level == 9 ? 2 : (job->strategy >= Z_HUFFMAN_ONLY || (job->level >= 0 && job->level < 2) ? 4 : 0);
+        buf[9] = OS_CODE;
+        if (gz_pool_put(pool->state, buf, 10) == -1)
+            return Z_ERRNO;
+        pool->crc = 0;
+        pool->isize = 0;
+    }
+    if (gz_pool_put(pool->state, job->out, job->have) == -1)
+        return Z_ERRNO;
+    pool->crc = PREFIX(crc32_combine)(pool->crc, job->crc, job->len);
+    pool->isize += job->len;
+    if (job->last) {
+        buf[0] = (unsigned char)pool->crc;
+        buf[1] = (unsigned char)(pool->crc >> 8);
+        buf[2] = (unsigned char)(pool->crc >> 16);
+        buf[3] = (unsigned char)(pool->crc >> 24);
+        buf[4] = (unsigned char)pool->isize;
+        buf[5] = (unsigned char)(pool->isize >> 8);
+        buf[6] = (unsigned char)(pool->isize >> 16);
+        buf[7] = (unsigned char)(pool->isize >> 24);
+        if (gz_pool_put(pool->state, buf, 8) == -1)
+            return Z_ERRNO;
+    }
+    return Z_OK;
+}
+
+static void gz_pool_writer(void *arg) {
+    gz_pool *pool = (gz_pool *)arg;
+    gz_job *job;
+    int err;
+
+    zmutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && pool->jobs[pool->done].status != GZ_JOB_DONE)
+            zcond_wait(&pool->cond, &pool->lock);
+        if (pool->quit)
+            break;
+        job = &pool->jobs[pool->done];
+        err = pool->err;
+        zmutex_unlock(&pool->lock);
+
+        /* after an error the remaining chunks are dropped, so that the application does not wait forever */
+        if (err == Z_OK)
+            err = gz_pool_write(pool, job);
+
+        zmutex_lock(&pool->lock);
+        if (err != Z_OK && pool->err == Z_OK) {
+            pool->err = err;
+            pool->errnum = errno;
+        }
+        job->status = GZ_JOB_FREE;
+        pool->done = (pool->done + 1) % pool->count;
+        pool->pending--;
+        zcond_broadcast(&pool->cond);
+    }
+    zmutex_unlock(&pool->lock);
+}
+
+/* Free the pool after its threads exited, or before they were started */
+static void gz_pool_free(gz_pool *pool) {
+    unsigned i;
+
+    if (pool->jobs != NULL) {
+        for (i = 0; i < pool->count; i++) {
+            zng_free(pool->jobs[i].out);
+            zng_free(pool->jobs[i].in);
+        }
+        zng_free(pool->jobs);
+    }
+    while (pool->strm_count > 0)
+        (void)PREFIX(deflateEnd)(&pool->strms[--pool->strm_count]);
+    zng_free(pool->strms);
+    zng_free(pool->workers);
+    zcond_destroy(&pool->cond);
+    zmutex_destroy(&pool->lock);
+    zng_free(pool);
+}
+
+/* Stop the threads and free the pool, all jobs must have been written */
+static void gz_pool_end(gz_pool *pool) {
+    zmutex_lock(&pool->lock);
+    pool->quit = 1;
+    zcond_broadcast(&pool->cond);
+    zmutex_unlock(&pool->lock);
+    zthread_join(&pool->writer);
+    while (pool->threads > 0)
+        zthread_join(&pool->workers[--pool->threads]);
+    gz_pool_free(pool);
+}
+
+/* Set up background compression on state->threads threads. Return -1 on a memory allocation failure, or 0
+   otherwise. state->pool is left NULL if the threads could not be started. */
+static int gz_pool_init(gz_state *state) {
+    gz_pool *pool;
+    int32_t threads = MIN(state->threads, ZTHREAD_MAX);
+    unsigned i;
+
+    pool = (gz_pool *)zng_alloc(sizeof(gz_pool));
+    if (pool == NULL)
+        return -1;
+    memset(pool, 0, sizeof(gz_pool));
+    zmutex_init(&pool->lock);
+    zcond_init(&pool->cond);
+    pool->state = state;
+    pool->fresh = 1;
+
+    /* enough jobs to keep every worker busy while the application fills one and the writer writes one */
+    pool->count = 2 * (unsigned)threads + 2;
+    pool->size = state->bgzf ? BGZF_BLOCK : state->want;
+    pool->out_size = state->bgzf ? BGZF_MAX : (unsigned)PREFIX(compressBound)(state->want) + 16;
+    pool->jobs = (gz_job *)zng_alloc(pool->count * sizeof(gz_job));
+    pool->strms = (PREFIX3(stream) *)zng_alloc(threads * sizeof(PREFIX3(stream)));
+    pool->workers = (zthread *)zng_alloc(threads * sizeof(zthread));
+    if (pool->jobs == NULL || pool->strms == NULL || pool->workers == NULL) {
+        gz_pool_free(pool);
+        return -1;
+    }
+    memset(pool->jobs, 0, pool->count * sizeof(gz_job));
+    for (i = 0; i < pool->count; i++) {
+        pool->jobs[i].in = (unsigned char *)zng_alloc(GZ_DICT + pool->size);
+        pool->jobs[i].out = (unsigned char *)zng_alloc(pool->out_size);
+        if (pool->jobs[i].in == NULL || pool->jobs[i].out == NULL) {
+            gz_pool_free(pool);
+            return -1;
+        }
+    }
+    memset(pool->strms, 0, threads * sizeof(PREFIX3(stream)));
+    while (pool->strm_count < threads) {
+        if (PREFIX(deflateInit2)(&pool->strms[pool->strm_count], state->level, Z_DEFLATED, -MAX_WBITS,
+                                 DEF_MEM_LEVEL, state->strategy) != Z_OK) {
+            gz_pool_free(pool);
+            return -1;
+        }
+        pool->strm_count++;
+    }
+
+    if (zthread_create(&pool->writer, gz_pool_writer, pool) != 0) {
+        gz_pool_free(pool);
+        return 0;
+    }
+    while (pool->threads < threads && zthread_create(&pool->workers[pool->threads], gz_pool_worker, pool) == 0)
+        pool->threads++;
+    if (pool->threads == 0) {
+        gz_pool_end(pool);
+        return 0;
+    }
+    state->pool = pool;
+    return 0;
+}
+
+/* Report an error of the background threads, return -1 if there was one, or 0 otherwise */
+static int gz_pool_error(gz_state *state) {
+    gz_pool *pool = state->pool;
+    int err, errnum;
+
+    zmutex_lock(&pool->lock);
+    err = pool->err;
+    errnum = pool->errnum;
+    zmutex_unlock(&pool->lock);
+    if (err == Z_OK)
+        return 0;
+    if (state->err == Z_OK) {
+        if (err == Z_ERRNO) {
+            errno = errnum;
+            gz_error(state, Z_ERRNO, zstrerror());
+        } else if (err == Z_MEM_ERROR) {
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+        } else {
+            gz_error(state, Z_STREAM_ERROR, "internal error: deflate stream corrupt");
+        }
+    }
+    return -1;
+}
+
+/* Return the job being filled, taking the next one if there is none. The end of the previous chunk is copied in
+   front of it to be used as the dictionary. */
+static gz_job *gz_pool_job(gz_pool *pool) {
+    gz_job *job, *prev;
+
+    if (pool->job != NULL)
+        return pool->job;
+
+    job = &pool->jobs[pool->fill];
+    zmutex_lock(&pool->lock);
+    while (job->status != GZ_JOB_FREE)
+        zcond_wait(&pool->cond, &pool->lock);
+    zmutex_unlock(&pool->lock);
+
+    /* the previous job is only read, even if it was written already, it is not reused before this one */
+    job->dict = 0;
+    if (!pool->fresh && !pool->state->bgzf) {
+        prev = &pool->jobs[(pool->fill + pool->count - 1) % pool->count];
+        job->dict = MIN(GZ_DICT, prev->dict + prev->len);
+        memcpy(job->in, prev->in + prev->dict + prev->len - job->dict, job->dict);
+    }
+    job->len = 0;
+    job->first = !pool->member;
+    pool->member = 1;
+    pool->fresh = 0;
+    pool->job = job;
+    return job;
+}
+
+/* Hand the job being filled to the workers */
+static void gz_pool_submit(gz_state *state, int last) {
+    gz_pool *pool = state->pool;
+    gz_job *job = pool->job;
+
+    job->level = state->level;
+    job->strategy = state->strategy;
+    job->last = last;
+    if (last) {
+        pool->member = 0;
+        pool->fresh = 1;
+    }
+    pool->job = NULL;
+
+    zmutex_lock(&pool->lock);
+    job->status = GZ_JOB_READY;
+    pool->fill = (pool->fill + 1) % pool->count;
+    pool->pending++;
+    zcond_broadcast(&pool->cond);
+    zmutex_unlock(&pool->lock);
+}
+
+/* gz_comp() for background compression. The input is copied into chunks, that are handed to the workers when full
+   or when flushing. Flushing other than with Z_BLOCK waits for everything to be written. */
+static int gz_comp_pool(gz_state *state, int flush) {
+    gz_pool *pool = state->pool;
+    PREFIX3(stream) *strm = &(state->strm);
+    gz_job *job;
+    unsigned copy;
+
+    if (gz_pool_error(state) == -1)
+        return -1;
+
+    /* check for a pending reset */
+    if (state->reset) {
+        /* don't start a new gzip member unless there is data to write */
+        if (strm->avail_in == 0)
+            return 0;
+        state->reset = 0;
+    }
+
+    while (strm->avail_in) {
+        job = gz_pool_job(pool);
+        copy = MIN(pool->size - job->len, strm->avail_in);
+        memcpy(job->in + job->dict + job->len, strm->next_in, copy);
+        job->len += copy;
+        strm->next_in += copy;
+        strm->avail_in -= copy;
+        if (job->len == pool->size)
+            gz_pool_submit(state, 0);
+    }
+    if (flush == Z_NO_FLUSH)
+        return 0;
+
+    if (flush == Z_FINISH && !state->bgzf) {
+        gz_pool_job(pool);
+        gz_pool_submit(state, 1);
+        state->reset = 1;
+    } else if (pool->job != NULL) {
+        gz_pool_submit(state, 0);
+    }
+    if (flush == Z_FULL_FLUSH)
+        pool->fresh = 1;
+    if (flush == Z_BLOCK)
+        return 0;
+
+    zmutex_lock(&pool->lock);
+    while (pool->pending)
+        zcond_wait(&pool->cond, &pool->lock);
+    zmutex_unlock(&pool->lock);
+    return gz_pool_error(state);
+}
+#endif
+
 /* Initialize state for writing a gzip file.  Mark initialization by setting
    state->size to non-zero.  Return -1 on a memory allocation failure, or 0 on
    success. */
@@ -29,22 +625,40 @@ static int gz_init(gz_state *state) {
     }
     memset(state->in, 0, state->want << 1);
 
-    /* only need output buffer and deflate state if compressing */
-    if (!state->direct) {
+#ifdef WITH_THREADS
+    /* start background compression if requested */
+    if (!state->direct && state->threads && gz_pool_init(state) == -1) {
+        zng_free(state->in);
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+#endif
+
+    /* only need output buffer and deflate state if compressing here, for BGZF a buffer for one block of each */
+    if (!state->direct && state->pool == NULL) {
         /* allocate output buffer */
-        state->out = (unsigned char *)zng_alloc(state->want);
+        state->out = (unsigned char *)zng_alloc(state->bgzf ? BGZF_MAX : state->want);
+        if (state->bgzf && state->out != NULL) {
+            state->block = (unsigned char *)zng_alloc(BGZF_BLOCK);
+            if (state->block == NULL) {
+                zng_free(state->out);
+                state->out = NULL;
+            }
+        }
         if (state->out == NULL) {
             zng_free(state->in);
             gz_error(state, Z_MEM_ERROR, "out of memory");
             return -1;
         }
 
-        /* allocate deflate memory, set up for gzip compression */
+        /* allocate deflate memory, set up for gzip compression, or raw deflate for BGZF blocks */
         strm->zalloc = NULL;
         strm->zfree = NULL;
         strm->opaque = NULL;
-        ret = PREFIX(deflateInit2)(strm, state->level, Z_DEFLATED, MAX_WBITS + 16, DEF_MEM_LEVEL, state->strategy);
+        ret = PREFIX(deflateInit2)(strm, state->level, Z_DEFLATED, state->bgzf ? -MAX_WBITS : MAX_WBITS + 16,
+                                   DEF_MEM_LEVEL, state->strategy);
         if (ret != Z_OK) {
+            zng_free(state->block);
             zng_free(state->out);
             zng_free(state->in);
             gz_error(state, Z_MEM_ERROR, "out of memory");
@@ -56,8 +670,8 @@ static int gz_init(gz_state *state) {
     /* mark state as initialized */
     state->size = state->want;
 
-    /* initialize write buffer if compressing */
-    if (!state->direct) {
+    /* initialize write buffer if compressing here */
+    if (!state->direct && state->pool == NULL && !state->bgzf) {
         strm->avail_out = state->size;
         strm->next_out = state->out;
         state->x.next = strm->next_out;
@@ -92,6 +706,13 @@ static int gz_comp(gz_state *state, int flush) {
         return 0;
     }
 
+#ifdef WITH_THREADS
+    if (state->pool != NULL)
+        return gz_comp_pool(state, flush);
+#endif
+    if (state->bgzf)
+        return gz_comp_bgzf(state, flush);
+
     /* check for a pending reset */
     if (state->reset) {
         /* don't start a new gzip member unless there is data to write */
@@ -476,16 +1097,42 @@ int Z_EXPORT PREFIX(gzsetparams)(gzFile file, int level, int strategy) {
 
     /* change compression parameters for subsequent input */
     if (state->size) {
-        /* flush previous input with previous parameters before changing */
-        if (strm->avail_in && gz_comp(state, Z_BLOCK) == -1)
+        /* flush previous input with previous parameters before changing, the chunk being filled when compressing
+           in the background */
+        if ((strm->avail_in || state->pool != NULL || state->bgzf) && gz_comp(state, Z_BLOCK) == -1)
             return state->err;
-        PREFIX(deflateParams)(strm, level, strategy);
+        if (state->pool == NULL && !state->bgzf)
+            PREFIX(deflateParams)(strm, level, strategy);
     }
     state->level = level;
     state->strategy = strategy;
     return Z_OK;
 }
 
+#ifndef ZLIB_COMPAT
+/* -- see zlib-ng.h -- */
+int32_t Z_EXPORT zng_gzbgzfindex(gzFile file, const char *path) {
+    gz_state *state;
+    char *copy;
+
+    /* get internal structure */
+    if (file == NULL || path == NULL)
+        return -1;
+    state = (gz_state *)file;
+
+    /* check that we're writing BGZF and haven't allocated the buffers yet */
+    if (state->mode != GZ_WRITE || !state->bgzf || state->direct || state->size != 0)
+        return -1;
+    copy = (char *)malloc(strlen(path) + 1);
+    if (copy == NULL)
+        return -1;
+    strcpy(copy, path);
+    free(state->gzi);
+    state->gzi = copy;
+    return 0;
+}
+#endif
+
 /* -- see zlib.h -- */
 int Z_EXPORT PREFIX(gzclose_w)(gzFile file) {
     int ret = Z_OK;
@@ -510,13 +1157,31 @@ int Z_EXPORT PREFIX(gzclose_w)(gzFile file) {
     /* flush, free memory, and close file */
     if (gz_comp(state, Z_FINISH) == -1)
         ret = state->err;
+    if (state->bgzf && !state->direct && state->size && ret == Z_OK) {
+        /* mark the end of the BGZF file, the threads are done writing */
+        ssize_t got = write(state->fd, bgzf_eof, sizeof(bgzf_eof));
+        if (got < 0 || (unsigned)got != sizeof(bgzf_eof)) {
+            gz_error(state, Z_ERRNO, zstrerror());
+            ret = state->err;
+        } else if (state->gzi != NULL && gz_bgzf_index(state) == -1) {
+            gz_error(state, Z_ERRNO, zstrerror());
+            ret = state->err;
+        }
+    }
     if (state->size) {
-        if (!state->direct) {
+        if (state->pool != NULL) {
+#ifdef WITH_THREADS
+            gz_pool_end(state->pool);
+#endif
+        } else if (!state->direct) {
             (void)PREFIX(deflateEnd)(&(state->strm));
+            zng_free(state->block);
             zng_free(state->out);
         }
         zng_free(state->in);
     }
+    free(state->gzi_list);
+    free(state->gzi);
     gz_error(state, Z_OK, NULL);
     free(state->path);
     if (close(state->fd) == -1)
@@ -93,7 +93,7 @@ int32_t Z_EXPORT PREFIX(inflateBackInit_)(PREFIX3(stream) *strm, int32_t windowB
     do { \
         PULL(); \
         have--; \
-        hold += ((unsigned)(*next++) << bits); \
+        hold += ((uint64_t)(*next++) << bits); \
         bits += 8; \
     } while (0)
 
@@ -145,7 +145,7 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
     z_const unsigned char *next; /* next input */
     unsigned char *put;          /* next output */
     unsigned have, left;         /* available input and output */
-    uint32_t hold;               /* bit buffer */
+    uint64_t hold;               /* bit buffer */
     unsigned bits;               /* bits in bit buffer */
     unsigned copy;               /* number of stored or match bytes to copy */
     unsigned char *from;         /* where to copy match bytes from */
@@ -278,14 +278,14 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
                 for (;;) {
                     here = state->lencode[BITS(state->lenbits)];
                     if (here.bits <= bits) break;
-                    PULLBYTE();
+                    PULLBITS();
                 }
                 if (here.val < 16) {
                     DROPBITS(here.bits);
                     state->lens[state->have++] = here.val;
                 } else {
                     if (here.val == 16) {
-                        NEEDBITS(here.bits + 2);
+                        FILLBITS(here.bits + 2);
                         DROPBITS(here.bits);
                         if (state->have == 0) {
                             SET_BAD("invalid bit length repeat");
@@ -295,13 +295,13 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
                         copy = 3 + BITS(2);
                         DROPBITS(2);
                     } else if (here.val == 17) {
-                        NEEDBITS(here.bits + 3);
+                        FILLBITS(here.bits + 3);
                         DROPBITS(here.bits);
                         len = 0;
                         copy = 3 + BITS(3);
                         DROPBITS(3);
                     } else {
-                        NEEDBITS(here.bits + 7);
+                        FILLBITS(here.bits + 7);
                         DROPBITS(here.bits);
                         len = 0;
                         copy = 11 + BITS(7);
@@ -357,7 +357,7 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
                 RESTORE();
                 if (state->whave < state->wsize)
                     state->whave = state->wsize - left;
-                zng_inflate_fast(strm, state->wsize);
+                functable.inflate_fast(strm, state->wsize);
                 LOAD();
                 break;
             }
@@ -365,9 +365,11 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
             /* get a literal, length, or end-of-block code */
             for (;;) {
                 here = state->lencode[BITS(state->lenbits)];
+                if (here.op & 128)
+                    UNPAIR(here);
                 if (here.bits <= bits)
                     break;
-                PULLBYTE();
+                PULLBITS();
             }
             if (here.op && (here.op & 0xf0) == 0) {
                 last = here;
@@ -375,7 +377,7 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
                     here = state->lencode[last.val + (BITS(last.bits + last.op) >> last.bits)];
                     if ((unsigned)last.bits + (unsigned)here.bits <= bits)
                         break;
-                    PULLBYTE();
+                    PULLBITS();
                 }
                 DROPBITS(last.bits);
             }
@@ -397,6 +399,8 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
             /* process end of block */
             if (here.op & 32) {
                 Tracevv((stderr, "inflate:         end of block\n"));
+                len = bits >> 3;
+                UNPULLBYTES(len);
                 state->mode = TYPE;
                 break;
             }
@@ -410,7 +414,7 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
             /* length code -- get extra bits, if any */
             state->extra = (here.op & 15);
             if (state->extra) {
-                NEEDBITS(state->extra);
+                FILLBITS(state->extra);
                 state->length += BITS(state->extra);
                 DROPBITS(state->extra);
             }
@@ -421,7 +425,7 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
                 here = state->distcode[BITS(state->distbits)];
                 if (here.bits <= bits)
                     break;
-                PULLBYTE();
+                PULLBITS();
             }
             if ((here.op & 0xf0) == 0) {
                 last = here;
@@ -429,7 +433,7 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
                     here = state->distcode[last.val + (BITS(last.bits + last.op) >> last.bits)];
                     if ((unsigned)last.bits + (unsigned)here.bits <= bits)
                         break;
-                    PULLBYTE();
+                    PULLBITS();
                 }
                 DROPBITS(last.bits);
             }
@@ -443,7 +447,7 @@ int32_t Z_EXPORT PREFIX(inflateBack)(PREFIX3(stream) *strm, in_func in, void *in
 
             /* get distance extra bits, if any */
             if (state->extra) {
-                NEEDBITS(state->extra);
+                FILLBITS(state->extra);
                 state->offset += BITS(state->extra);
                 DROPBITS(state->extra);
             }
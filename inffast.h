@@ -10,8 +10,6 @@
    subject to change. Applications should only use zlib.h.
  */
 
-void Z_INTERNAL zng_inflate_fast(PREFIX3(stream) *strm, unsigned long start);
-
 #define INFLATE_FAST_MIN_HAVE 8
 #define INFLATE_FAST_MIN_LEFT 258
 
@@ -12,6 +12,7 @@
 #include "inflate_p.h"
 #include "inffixed_tbl.h"
 #include "functable.h"
+#include "zprobe.h"
 
 /* Avoid conflicts with zlib.h macros */
 #ifdef ZLIB_COMPAT
@@ -82,6 +83,9 @@ int32_t Z_EXPORT PREFIX(inflateResetKeep)(PREFIX3(stream) *strm) {
     state->lencode = state->distcode = state->next = state->codes;
     state->sane = 1;
     state->back = -1;
+#ifdef WITH_STATS
+    memset(&state->stat, 0, sizeof(state->stat));
+#endif
     INFLATE_RESET_KEEP_HOOK(strm);  /* hook for IBM Z DFLTCC */
     Tracev((stderr, "inflate: reset\n"));
     return Z_OK;
@@ -96,6 +100,7 @@ int32_t Z_EXPORT PREFIX(inflateReset)(PREFIX3(stream) *strm) {
     state->wsize = 0;
     state->whave = 0;
     state->wnext = 0;
+    state->dhave = 0;
     return PREFIX(inflateResetKeep)(strm);
 }
 
@@ -141,7 +146,7 @@ int32_t ZNG_CONDEXPORT PREFIX(inflateInit2)(PREFIX3(stream) *strm, int32_t windo
     int32_t ret;
     struct inflate_state *state;
 
-    cpu_check_features();
+    functable_init();
 
     if (strm == NULL)
         return Z_STREAM_ERROR;
@@ -159,6 +164,14 @@ int32_t ZNG_CONDEXPORT PREFIX(inflateInit2)(PREFIX3(stream) *strm, int32_t windo
     strm->state = (struct internal_state *)state;
     state->strm = strm;
     state->window = NULL;
+    state->windowless = 0;
+    state->outhint = 0;
+    state->discard = 0;
+    state->scratch = NULL;
+    state->treelen = 0;
+#ifdef WITH_STATS
+    state->stats = 0;
+#endif
     state->mode = HEAD;     /* to pass state test in inflateReset2() */
     state->chunksize = functable.chunksize();
     ret = PREFIX(inflateReset2)(strm, windowBits);
@@ -221,13 +234,61 @@ void Z_INTERNAL fixedtables(struct inflate_state *state) {
     state->distbits = 5;
 }
 
+/*
+   Dynamic blocks of streams flushed often, such as one message per Z_SYNC_FLUSH,
+   tend to repeat the same code lengths.  The tables of the last dynamic block
+   are left in codes[], so inflate_tables_cached() checks whether the code
+   lengths just read in lens[] are the ones they were built from, and if so
+   points the decoding tables at them again instead of rebuilding.  The hash
+   only rules out most mismatches quickly, the code lengths are then compared.
+ */
+
+static uint32_t inflate_tables_hash(struct inflate_state *state) {
+    return functable.crc32(state->nlen, (const uint8_t *)state->lens,
+                           (state->nlen + state->ndist) * sizeof(state->lens[0]));
+}
+
+static int inflate_tables_cached(struct inflate_state *state) {
+    unsigned len = state->nlen + state->ndist;
+
+    if (len != state->treelen || state->nlen != state->treenlen || inflate_tables_hash(state) != state->treehash ||
+        memcmp(state->lens, state->treelens, len * sizeof(state->lens[0])) != 0) {
+        /* codes[] is about to be overwritten */
+        state->treelen = 0;
+        return 0;
+    }
+    state->lencode = state->codes;
+    state->lenbits = state->treelenbits;
+    state->distcode = state->codes + state->treedist;
+    state->distbits = state->treedistbits;
+    state->next = state->codes + state->treeused;
+    return 1;
+}
+
+static void inflate_tables_save(struct inflate_state *state) {
+    unsigned len = state->nlen + state->ndist;
+
+    state->treelen = len;
+    state->treenlen = state->nlen;
+    state->treelenbits = state->lenbits;
+    state->treedistbits = state->distbits;
+    state->treedist = (uint32_t)(state->distcode - state->codes);
+    state->treeused = (uint32_t)(state->next - state->codes);
+    state->treehash = inflate_tables_hash(state);
+    memcpy(state->treelens, state->lens, len * sizeof(state->lens[0]));
+}
+
 int Z_INTERNAL PREFIX(inflate_ensure_window)(struct inflate_state *state) {
     /* if it hasn't been done already, allocate space for the window */
     if (state->window == NULL) {
         unsigned wsize = 1U << state->wbits;
+        /* when little output is expected, a smaller window holds all of it, see updatewindow() */
+        if (state->outhint > 0 && state->outhint < wsize && INFLATE_NEED_UPDATEWINDOW(state->strm))
+            wsize = MAX((unsigned)state->outhint, 256);
         state->window = (unsigned char *)ZALLOC_WINDOW(state->strm, wsize + state->chunksize, sizeof(unsigned char));
         if (state->window == NULL)
             return Z_MEM_ERROR;
+        state->wbufsize = wsize;
 #ifdef Z_MEMORY_SANITIZER
         /* This is _not_ to subvert the memory sanitizer but to instead unposion some
            data we willingly and purposefully load uninitialized into vector registers
@@ -238,7 +299,7 @@ int Z_INTERNAL PREFIX(inflate_ensure_window)(struct inflate_state *state) {
 
     /* if window not in use yet, initialize */
     if (state->wsize == 0) {
-        state->wsize = 1U << state->wbits;
+        state->wsize = state->wbufsize;
         state->wnext = 0;
         state->whave = 0;
     }
@@ -246,6 +307,68 @@ int Z_INTERNAL PREFIX(inflate_ensure_window)(struct inflate_state *state) {
     return Z_OK;
 }
 
+/*
+   Decode and check the input without writing any output, for the discard
+   parameter of zng_inflateSetParams(). The output goes to a scratch buffer
+   instead, for as long as inflate() fills it, so that one call consumes as
+   much input as a call with an unlimited output buffer would. next_out and
+   avail_out are left alone, total_out counts the discarded output.
+ */
+#define INFLATE_DISCARD_SIZE 65536
+
+static int32_t inflate_discard(PREFIX3(stream) *strm, int32_t flush) {
+    struct inflate_state *state = (struct inflate_state *)strm->state;
+    unsigned char *next_out = strm->next_out;
+    uint32_t avail_out = strm->avail_out;
+    unsigned long total_in = strm->total_in, total_out = strm->total_out;
+    int32_t ret;
+
+    if (state->scratch == NULL) {
+        state->scratch = (unsigned char *)ZALLOC(strm, INFLATE_DISCARD_SIZE, sizeof(unsigned char));
+        if (state->scratch == NULL)
+            return Z_MEM_ERROR;
+    }
+
+    state->discard = 0;
+    do {
+        strm->next_out = state->scratch;
+        strm->avail_out = INFLATE_DISCARD_SIZE;
+        ret = PREFIX(inflate)(strm, flush == Z_FINISH ? Z_NO_FLUSH : flush);
+    } while (ret == Z_OK && strm->avail_out == 0);
+    state->discard = 1;
+    strm->next_out = next_out;
+    strm->avail_out = avail_out;
+
+    /* report progress as a single inflate() call would */
+    if (ret == Z_BUF_ERROR && (strm->total_in != total_in || strm->total_out != total_out))
+        ret = Z_OK;
+    if (ret == Z_OK && flush == Z_FINISH)
+        ret = Z_BUF_ERROR;
+    return ret;
+}
+
+/*
+   Decode without a sliding window, resolving all distances in the output
+   buffer. This is only valid if the output of every inflate() call directly
+   follows the output of the previous call in memory and stays there, as when
+   decompressing into one contiguous buffer. The window is then never allocated
+   and no output is copied into it. Must be called before any output is
+   produced; inflateSetDictionary() switches back to using a window.
+ */
+int Z_INTERNAL PREFIX(inflate_windowless)(PREFIX3(stream) *strm) {
+    struct inflate_state *state;
+
+    if (inflateStateCheck(strm))
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state *)strm->state;
+    /* hardware inflate (s390 DFLTCC) maintains the window itself */
+    if (state->total != 0 || state->whave != 0 || !INFLATE_NEED_UPDATEWINDOW(strm))
+        return Z_STREAM_ERROR;
+    state->windowless = 1;
+    state->dhave = 0;
+    return Z_OK;
+}
+
 /*
    Update the window with the last wsize (normally 32K) bytes written before
    returning.  If window does not exist yet, create it.  This is only called
@@ -268,6 +391,23 @@ static int32_t updatewindow(PREFIX3(stream) *strm, const uint8_t *end, uint32_t
 
     if (PREFIX(inflate_ensure_window)(state)) return 1;
 
+    /* a window sized by the output size hint never wraps around, it holds all
+       of the output so far -- move that to a full size window before it would */
+    if (state->wsize < (1U << state->wbits) && state->whave + len > state->wsize) {
+        unsigned wsize = 1U << state->wbits;
+        unsigned char *window = (unsigned char *)ZALLOC_WINDOW(strm, wsize + state->chunksize, sizeof(unsigned char));
+        if (window == NULL)
+            return 1;
+#ifdef Z_MEMORY_SANITIZER
+        __msan_unpoison(window + wsize, state->chunksize);
+#endif
+        memcpy(window, state->window, state->whave);
+        ZFREE_WINDOW(strm, state->window);
+        state->window = window;
+        state->wbufsize = state->wsize = wsize;
+        state->wnext = state->whave;
+    }
+
     /* len state->wsize or less output bytes into the circular window */
     if (len >= state->wsize) {
         /* Only do this if the caller specifies to checksum bytes AND the platform requires
@@ -316,6 +456,10 @@ static int32_t updatewindow(PREFIX3(stream) *strm, const uint8_t *end, uint32_t
     return 0;
 }
 
+/* output buffers large enough to fall out of the cache before inflate() returns, for which
+   stored data is better added to the check value as it is copied than read back afterwards */
+#define INFLATE_COPY_BULK (2 * 1024 * 1024)
+
 /*
    Private macros for inflate()
    Look in inflate_p.h for macros shared with inflateBack()
@@ -326,7 +470,7 @@ static int32_t updatewindow(PREFIX3(stream) *strm, const uint8_t *end, uint32_t
     do { \
         if (have == 0) goto inf_leave; \
         have--; \
-        hold += ((unsigned)(*next++) << bits); \
+        hold += ((uint64_t)(*next++) << bits); \
         bits += 8; \
     } while (0)
 
@@ -367,8 +511,11 @@ static int32_t updatewindow(PREFIX3(stream) *strm, const uint8_t *end, uint32_t
 
    NEEDBITS(n) uses PULLBYTE() to get an available byte of input, or to return
    if there is no input available.  The decoding of variable length codes uses
-   PULLBYTE() directly in order to pull just enough bytes to decode the next
-   code, and no more.
+   PULLBITS() and FILLBITS() instead, which load up to 64 bits at once when
+   enough input is available.  The whole bytes read ahead that way are handed
+   back with UNPULLBYTES() at the end of the block and when inflate() returns,
+   so that the header, stored block and trailer states still see exactly the
+   bytes they need.
 
    Some states loop until they get enough input, making sure that enough
    state information is maintained to continue the loop where it left off
@@ -417,9 +564,10 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
     const unsigned char *next;  /* next input */
     unsigned char *put;         /* next output */
     unsigned have, left;        /* available input and output */
-    uint32_t hold;              /* bit buffer */
+    uint64_t hold;              /* bit buffer */
     unsigned bits;              /* bits in bit buffer */
     uint32_t in, out;           /* save starting available input and output */
+    uint32_t ckleft;            /* available output when the check value was last updated */
     unsigned copy;              /* number of stored or match bytes to copy */
     unsigned char *from;        /* where to copy match bytes from */
     code here;                  /* current decoding table entry */
@@ -432,16 +580,20 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
     static const uint16_t order[19] = /* permutation of code lengths */
         {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
 
-    if (inflateStateCheck(strm) || strm->next_out == NULL ||
-        (strm->next_in == NULL && strm->avail_in != 0))
+    if (inflateStateCheck(strm))
         return Z_STREAM_ERROR;
-
     state = (struct inflate_state *)strm->state;
+    if (state->discard)
+        return inflate_discard(strm, flush);
+    if (strm->next_out == NULL || (strm->next_in == NULL && strm->avail_in != 0))
+        return Z_STREAM_ERROR;
+
     if (state->mode == TYPE)      /* skip check */
         state->mode = TYPEDO;
     LOAD();
     in = have;
     out = left;
+    ckleft = left;
     ret = Z_OK;
     for (;;)
         switch (state->mode) {
@@ -513,7 +665,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
         case TIME:
             NEEDBITS(32);
             if (state->head != NULL)
-                state->head->time = hold;
+                state->head->time = (unsigned long)hold;
             if ((state->flags & 0x0200) && (state->wrap & 4))
                 CRC4(state->check, hold);
             INITBITS();
@@ -634,7 +786,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
 #endif
         case DICTID:
             NEEDBITS(32);
-            strm->adler = state->check = ZSWAP32(hold);
+            strm->adler = state->check = ZSWAP32((uint32_t)hold);
             INITBITS();
             state->mode = DICT;
 
@@ -661,14 +813,17 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
             NEEDBITS(3);
             state->last = BITS(1);
             DROPBITS(1);
+            PROBE2(inflate_type, BITS(2), state->last);
             switch (BITS(2)) {
             case 0:                             /* stored block */
                 Tracev((stderr, "inflate:     stored block%s\n", state->last ? " (last)" : ""));
+                INFLATE_STAT(state, stored_blocks, 1);
                 state->mode = STORED;
                 break;
             case 1:                             /* fixed block */
                 fixedtables(state);
                 Tracev((stderr, "inflate:     fixed codes block%s\n", state->last ? " (last)" : ""));
+                INFLATE_STAT(state, fixed_blocks, 1);
                 state->mode = LEN_;             /* decode codes */
                 if (flush == Z_TREES) {
                     DROPBITS(2);
@@ -677,6 +832,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                 break;
             case 2:                             /* dynamic block */
                 Tracev((stderr, "inflate:     dynamic codes block%s\n", state->last ? " (last)" : ""));
+                INFLATE_STAT(state, dynamic_blocks, 1);
                 state->mode = TABLE;
                 break;
             case 3:
@@ -711,7 +867,15 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                 copy = MIN(copy, left);
                 if (copy == 0)
                     goto inf_leave;
-                memcpy(put, next, copy);
+                if (out >= INFLATE_COPY_BULK && INFLATE_NEED_CHECKSUM(strm) && (state->wrap & 4)) {
+                    /* copy and add to the check value in one pass, rather than reading the output back later */
+                    if (ckleft != left)
+                        inf_chksum(strm, put - (ckleft - left), ckleft - left);
+                    inf_chksum_cpy(strm, put, next, copy);
+                    ckleft = left - copy;
+                } else {
+                    memcpy(put, next, copy);
+                }
                 have -= copy;
                 next += copy;
                 left -= copy;
@@ -732,6 +896,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
             DROPBITS(5);
             state->ncode = BITS(4) + 4;
             DROPBITS(4);
+            PROBE3(inflate_table, state->nlen, state->ndist, state->ncode);
 #ifndef PKZIP_BUG_WORKAROUND
             if (state->nlen > 286 || state->ndist > 30) {
                 SET_BAD("too many length or distance symbols");
@@ -751,7 +916,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
             }
             while (state->have < 19)
                 state->lens[order[state->have++]] = 0;
-            state->next = state->codes;
+            state->next = state->ccodes;
             state->lencode = (const code *)(state->next);
             state->lenbits = 7;
             ret = zng_inflate_table(CODES, state->lens, 19, &(state->next), &(state->lenbits), state->work);
@@ -760,6 +925,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                 break;
             }
             Tracev((stderr, "inflate:       code lengths ok\n"));
+            INFLATE_STAT(state, table_builds, 1);
             state->have = 0;
             state->mode = CODELENS;
 
@@ -769,14 +935,14 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                 for (;;) {
                     here = state->lencode[BITS(state->lenbits)];
                     if (here.bits <= bits) break;
-                    PULLBYTE();
+                    PULLBITS();
                 }
                 if (here.val < 16) {
                     DROPBITS(here.bits);
                     state->lens[state->have++] = here.val;
                 } else {
                     if (here.val == 16) {
-                        NEEDBITS(here.bits + 2);
+                        FILLBITS(here.bits + 2);
                         DROPBITS(here.bits);
                         if (state->have == 0) {
                             SET_BAD("invalid bit length repeat");
@@ -786,13 +952,13 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                         copy = 3 + BITS(2);
                         DROPBITS(2);
                     } else if (here.val == 17) {
-                        NEEDBITS(here.bits + 3);
+                        FILLBITS(here.bits + 3);
                         DROPBITS(here.bits);
                         len = 0;
                         copy = 3 + BITS(3);
                         DROPBITS(3);
                     } else {
-                        NEEDBITS(here.bits + 7);
+                        FILLBITS(here.bits + 7);
                         DROPBITS(here.bits);
                         len = 0;
                         copy = 11 + BITS(7);
@@ -819,6 +985,15 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                 break;
             }
 
+            /* reuse the tables in codes[] if this block has the same code lengths as the last one */
+            if (inflate_tables_cached(state)) {
+                Tracev((stderr, "inflate:       codes reused\n"));
+                state->mode = LEN_;
+                if (flush == Z_TREES)
+                    goto inf_leave;
+                break;
+            }
+
             /* build code tables -- note: do not change the lenbits or distbits
                values here (10 and 9) without reading the comments in inftrees.h
                concerning the ENOUGH constants, which depend on those values */
@@ -838,20 +1013,29 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                 SET_BAD("invalid distances set");
                 break;
             }
+            inflate_tables_save(state);
             Tracev((stderr, "inflate:       codes ok\n"));
+            INFLATE_STAT(state, table_builds, 2);
             state->mode = LEN_;
             if (flush == Z_TREES)
                 goto inf_leave;
 
         case LEN_:
+            PROBE0(inflate_len);
             state->mode = LEN;
 
         case LEN:
             /* use inflate_fast() if we have enough input and output */
             if (have >= INFLATE_FAST_MIN_HAVE && left >= INFLATE_FAST_MIN_LEFT) {
+#ifdef WITH_STATS
+                uint32_t fast_left = left;
+#endif
                 RESTORE();
-                zng_inflate_fast(strm, out);
+                PROBE2(inflate_fast_entry, have, left);
+                functable.inflate_fast(strm, out);
+                PROBE2(inflate_fast_exit, strm->avail_in, strm->avail_out);
                 LOAD();
+                INFLATE_STAT(state, fast_bytes, fast_left - left);
                 if (state->mode == TYPE)
                     state->back = -1;
                 break;
@@ -861,9 +1045,11 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
             /* get a literal, length, or end-of-block code */
             for (;;) {
                 here = state->lencode[BITS(state->lenbits)];
+                if (here.op & 128)
+                    UNPAIR(here);
                 if (here.bits <= bits)
                     break;
-                PULLBYTE();
+                PULLBITS();
             }
             if (here.op && (here.op & 0xf0) == 0) {
                 last = here;
@@ -871,7 +1057,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                     here = state->lencode[last.val + (BITS(last.bits + last.op) >> last.bits)];
                     if ((unsigned)last.bits + (unsigned)here.bits <= bits)
                         break;
-                    PULLBYTE();
+                    PULLBITS();
                 }
                 DROPBITS(last.bits);
                 state->back += last.bits;
@@ -892,6 +1078,8 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
             /* process end of block */
             if (here.op & 32) {
                 Tracevv((stderr, "inflate:         end of block\n"));
+                len = MIN(bits >> 3, in - have);
+                UNPULLBYTES(len);
                 state->back = -1;
                 state->mode = TYPE;
                 break;
@@ -910,7 +1098,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
         case LENEXT:
             /* get extra bits, if any */
             if (state->extra) {
-                NEEDBITS(state->extra);
+                FILLBITS(state->extra);
                 state->length += BITS(state->extra);
                 DROPBITS(state->extra);
                 state->back += state->extra;
@@ -925,7 +1113,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                 here = state->distcode[BITS(state->distbits)];
                 if (here.bits <= bits)
                     break;
-                PULLBYTE();
+                PULLBITS();
             }
             if ((here.op & 0xf0) == 0) {
                 last = here;
@@ -933,7 +1121,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                     here = state->distcode[last.val + (BITS(last.bits + last.op) >> last.bits)];
                     if ((unsigned)last.bits + (unsigned)here.bits <= bits)
                         break;
-                    PULLBYTE();
+                    PULLBITS();
                 }
                 DROPBITS(last.bits);
                 state->back += last.bits;
@@ -951,7 +1139,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
         case DISTEXT:
             /* get distance extra bits, if any */
             if (state->extra) {
-                NEEDBITS(state->extra);
+                FILLBITS(state->extra);
                 state->offset += BITS(state->extra);
                 DROPBITS(state->extra);
                 state->back += state->extra;
@@ -969,7 +1157,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
             /* copy match from window to output */
             if (left == 0)
                 goto inf_leave;
-            copy = out - left;
+            copy = out - left + state->dhave;
             if (state->offset > copy) {         /* copy from window */
                 copy = state->offset - copy;
                 if (copy > state->whave) {
@@ -1027,23 +1215,25 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
                 out -= left;
                 strm->total_out += out;
                 state->total += out;
+                INFLATE_STAT(state, slow_bytes, out);
+                PROBE1(inflate_check, state->total);
 
                 /* compute crc32 checksum if not in raw mode */
                 if (INFLATE_NEED_CHECKSUM(strm) && state->wrap & 4) {
-                    if (out) {
-                        inf_chksum(strm, put - out, out);
+                    if (ckleft != left) {
+                        inf_chksum(strm, put - (ckleft - left), ckleft - left);
                     }
 #ifdef GUNZIP
                     if (state->flags)
                         strm->adler = state->check = functable.crc32_fold_final(&state->crc_fold);
 #endif
                 }
-                out = left;
+                out = ckleft = left;
                 if ((state->wrap & 4) && (
 #ifdef GUNZIP
-                     state->flags ? hold :
+                     state->flags ? (uint32_t)hold :
 #endif
-                     ZSWAP32(hold)) != state->check) {
+                     ZSWAP32((uint32_t)hold)) != state->check) {
                     SET_BAD("incorrect data check");
                     break;
                 }
@@ -1091,12 +1281,35 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
        Note: a memory error from inflate() is non-recoverable.
      */
   inf_leave:
+    /* hand back whole bytes of input that PULLBITS() read ahead in this call, unless they are needed to go on once
+       the input ran out -- after a data error too, inflateSync() searches the input from there */
+    if (have != 0 || state->mode == BAD) {
+        len = MIN(bits >> 3, in - have);
+        UNPULLBYTES(len);
+    }
     RESTORE();
-    if (INFLATE_NEED_UPDATEWINDOW(strm) &&
+    if (state->windowless) {
+        /* the history stays in the output buffer, only update the check value */
+        len = ckleft - strm->avail_out;
+        if (INFLATE_NEED_CHECKSUM(strm) && (state->wrap & 4) && len && state->mode < BAD)
+            inf_chksum(strm, strm->next_out - len, len);
+        len = out - strm->avail_out;
+        if (len >= (1U << state->wbits))
+            state->dhave = 1U << state->wbits;
+        else
+            state->dhave = MIN(state->dhave + len, 1U << state->wbits);
+    } else if (INFLATE_NEED_UPDATEWINDOW(strm) &&
             (state->wsize || (out != strm->avail_out && state->mode < BAD &&
                  (state->mode < CHECK || flush != Z_FINISH)))) {
-        /* update sliding window with respective checksum if not in "raw" mode */
-        if (updatewindow(strm, strm->next_out, out - strm->avail_out, state->wrap & 4)) {
+        /* update sliding window with respective checksum if not in "raw" mode, the check value
+           may already cover the output up to the last stored block copy */
+        len = state->wrap & 4;
+        if (ckleft != out) {
+            if (INFLATE_NEED_CHECKSUM(strm) && len && ckleft != strm->avail_out && state->mode < BAD)
+                inf_chksum(strm, strm->next_out - (ckleft - strm->avail_out), ckleft - strm->avail_out);
+            len = 0;
+        }
+        if (updatewindow(strm, strm->next_out, out - strm->avail_out, len)) {
             state->mode = MEM;
             return Z_MEM_ERROR;
         }
@@ -1106,6 +1319,7 @@ int32_t Z_EXPORT PREFIX(inflate)(PREFIX3(stream) *strm, int32_t flush) {
     strm->total_in += in;
     strm->total_out += out;
     state->total += out;
+    INFLATE_STAT(state, slow_bytes, out);
 
     strm->data_type = (int)state->bits + (state->last ? 64 : 0) +
                       (state->mode == TYPE ? 128 : 0) + (state->mode == LEN_ || state->mode == COPY_ ? 256 : 0);
@@ -1121,6 +1335,8 @@ int32_t Z_EXPORT PREFIX(inflateEnd)(PREFIX3(stream) *strm) {
     state = (struct inflate_state *)strm->state;
     if (state->window != NULL)
         ZFREE_WINDOW(strm, state->window);
+    if (state->scratch != NULL)
+        ZFREE(strm, state->scratch);
     ZFREE_STATE(strm, strm->state);
     strm->state = NULL;
     Tracev((stderr, "inflate: end\n"));
@@ -1135,7 +1351,14 @@ int32_t Z_EXPORT PREFIX(inflateGetDictionary)(PREFIX3(stream) *strm, uint8_t *di
         return Z_STREAM_ERROR;
     state = (struct inflate_state *)strm->state;
 
-    /* copy dictionary */
+    /* copy dictionary, which is the end of the output when windowless */
+    if (state->windowless) {
+        if (state->dhave && dictionary != NULL)
+            memcpy(dictionary, strm->next_out - state->dhave, state->dhave);
+        if (dictLength != NULL)
+            *dictLength = state->dhave;
+        return Z_OK;
+    }
     if (state->whave && dictionary != NULL) {
         memcpy(dictionary, state->window + state->wnext, state->whave - state->wnext);
         memcpy(dictionary + state->whave - state->wnext, state->window, state->wnext);
@@ -1165,7 +1388,10 @@ int32_t Z_EXPORT PREFIX(inflateSetDictionary)(PREFIX3(stream) *strm, const uint8
     }
 
     /* copy dictionary to window using updatewindow(), which will amend the
-       existing dictionary if appropriate */
+       existing dictionary if appropriate -- the history is in the window from
+       now on */
+    state->windowless = 0;
+    state->dhave = 0;
     ret = updatewindow(strm, dictionary + dictLength, dictLength, 0);
     if (ret) {
         state->mode = MEM;
@@ -1225,7 +1451,7 @@ int32_t Z_EXPORT PREFIX(inflateSync)(PREFIX3(stream) *strm) {
     unsigned len;               /* number of bytes to look at or looked at */
     int flags;                  /* temporary to save header status */
     size_t in, out;             /* temporary to save total_in and total_out */
-    unsigned char buf[4];       /* to restore bit buffer to byte string */
+    unsigned char buf[8];       /* to restore bit buffer to byte string */
     struct inflate_state *state;
 
     /* check parameters */
@@ -1241,7 +1467,7 @@ int32_t Z_EXPORT PREFIX(inflateSync)(PREFIX3(stream) *strm) {
         state->hold <<= state->bits & 7;
         state->bits -= state->bits & 7;
         len = 0;
-        while (state->bits >= 8) {
+        while (state->bits >= 8 && len < sizeof(buf)) {
             buf[len++] = (unsigned char)(state->hold);
             state->hold >>= 8;
             state->bits -= 8;
@@ -1309,7 +1535,7 @@ int32_t Z_EXPORT PREFIX(inflateCopy)(PREFIX3(stream) *dest, PREFIX3(stream) *sou
         return Z_MEM_ERROR;
     window = NULL;
     if (state->window != NULL) {
-        wsize = 1U << state->wbits;
+        wsize = state->wbufsize;
         window = (unsigned char *)ZALLOC_WINDOW(source, wsize, sizeof(unsigned char));
         if (window == NULL) {
             ZFREE_STATE(source, copy);
@@ -1324,13 +1550,16 @@ int32_t Z_EXPORT PREFIX(inflateCopy)(PREFIX3(stream) *dest, PREFIX3(stream) *sou
     if (state->lencode >= state->codes && state->lencode <= state->codes + ENOUGH - 1) {
         copy->lencode = copy->codes + (state->lencode - state->codes);
         copy->distcode = copy->codes + (state->distcode - state->codes);
+    } else if (state->lencode == state->ccodes) {
+        copy->lencode = copy->ccodes;
     }
     copy->next = copy->codes + (state->next - state->codes);
     if (window != NULL) {
-        wsize = 1U << state->wbits;
+        wsize = state->wbufsize;
         memcpy(window, state->window, wsize);
     }
     copy->window = window;
+    copy->scratch = NULL;
     dest->state = (struct internal_state *)copy;
     return Z_OK;
 }
@@ -1383,3 +1612,210 @@ unsigned long Z_EXPORT PREFIX(inflateCodesUsed)(PREFIX3(stream) *strm) {
     state = (struct inflate_state *)strm->state;
     return (unsigned long)(state->next - state->codes);
 }
+
+#ifndef ZLIB_COMPAT
+/* Checks whether buffer size is sufficient and whether this parameter is a duplicate. */
+static int32_t inflateSetParamPre(zng_inflate_param_value **out, size_t min_size, zng_inflate_param_value *param) {
+    int32_t buf_error = param->size < min_size;
+
+    if (*out != NULL) {
+        (*out)->status = Z_BUF_ERROR;
+        buf_error = 1;
+    }
+    *out = param;
+    return buf_error;
+}
+
+int32_t Z_EXPORT zng_inflateSetParams(zng_stream *strm, zng_inflate_param_value *params, size_t count) {
+    size_t i;
+    struct inflate_state *state;
+    zng_inflate_param_value *new_verify_check = NULL;
+    zng_inflate_param_value *new_window = NULL;
+    zng_inflate_param_value *new_output_size = NULL;
+    zng_inflate_param_value *new_discard = NULL;
+    zng_inflate_param_value *new_stats = NULL;
+    int param_buf_error;
+    int version_error = 0;
+    int buf_error = 0;
+    int stream_error = 0;
+    int64_t size;
+    int val;
+
+    /* Initialize the statuses. */
+    for (i = 0; i < count; i++)
+        params[i].status = Z_OK;
+
+    /* Check whether the stream state is consistent. */
+    if (inflateStateCheck(strm))
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state *)strm->state;
+
+    /* Check buffer sizes and detect duplicates. */
+    for (i = 0; i < count; i++) {
+        switch (params[i].param) {
+            case Z_INFLATE_VERIFY_CHECK:
+                param_buf_error = inflateSetParamPre(&new_verify_check, sizeof(int), &params[i]);
+                break;
+            case Z_INFLATE_WINDOW:
+                param_buf_error = inflateSetParamPre(&new_window, sizeof(int), &params[i]);
+                break;
+            case Z_INFLATE_OUTPUT_SIZE:
+                param_buf_error = inflateSetParamPre(&new_output_size, sizeof(int64_t), &params[i]);
+                break;
+            case Z_INFLATE_DISCARD:
+                param_buf_error = inflateSetParamPre(&new_discard, sizeof(int), &params[i]);
+                break;
+            case Z_INFLATE_STATS:
+                param_buf_error = inflateSetParamPre(&new_stats, sizeof(int), &params[i]);
+                break;
+            default:
+                params[i].status = Z_VERSION_ERROR;
+                version_error = 1;
+                param_buf_error = 0;
+                break;
+        }
+        if (param_buf_error) {
+            params[i].status = Z_BUF_ERROR;
+            buf_error = 1;
+        }
+    }
+    /* Exit early if small buffers or duplicates are detected. */
+    if (buf_error)
+        return Z_BUF_ERROR;
+
+    /* Apply changes, remember if there were errors. */
+    if (new_verify_check != NULL)
+        PREFIX(inflateValidate)(strm, *(int *)new_verify_check->buf);
+    if (new_window != NULL) {
+        val = *(int *)new_window->buf;
+        if (val == Z_INFLATE_WINDOW_OUTPUT && !state->discard && PREFIX(inflate_windowless)(strm) == Z_OK) {
+            /* history is read from the output buffer */
+        } else if (val == Z_INFLATE_WINDOW_SLIDING && (!state->windowless || state->total == 0)) {
+            state->windowless = 0;
+        } else {
+            new_window->status = Z_STREAM_ERROR;
+            stream_error = 1;
+        }
+    }
+    if (new_output_size != NULL) {
+        size = *(int64_t *)new_output_size->buf;
+        if (size >= 0) {
+            state->outhint = size;
+        } else {
+            new_output_size->status = Z_STREAM_ERROR;
+            stream_error = 1;
+        }
+    }
+    if (new_discard != NULL) {
+        val = *(int *)new_discard->buf;
+        if (!val || !state->windowless) {
+            state->discard = val != 0;
+        } else {
+            new_discard->status = Z_STREAM_ERROR;
+            stream_error = 1;
+        }
+    }
+    if (new_stats != NULL) {
+        val = *(int *)new_stats->buf;
+#ifdef WITH_STATS
+        if (val && !state->stats)
+            memset(&state->stat, 0, sizeof(state->stat));
+        state->stats = val != 0;
+#else
+        if (val) {
+            new_stats->status = Z_VERSION_ERROR;
+            version_error = 1;
+        }
+#endif
+    }
+
+    /* Report version errors only if there are no real errors. */
+    return stream_error ? Z_STREAM_ERROR : (version_error ? Z_VERSION_ERROR : Z_OK);
+}
+
+int32_t Z_EXPORT zng_inflateGetParams(zng_stream *strm, zng_inflate_param_value *params, size_t count) {
+    struct inflate_state *state;
+    size_t i;
+    int32_t buf_error = 0;
+    int32_t version_error = 0;
+
+    /* Initialize the statuses. */
+    for (i = 0; i < count; i++)
+        params[i].status = Z_OK;
+
+    /* Check whether the stream state is consistent. */
+    if (inflateStateCheck(strm))
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state *)strm->state;
+
+    for (i = 0; i < count; i++) {
+        switch (params[i].param) {
+            case Z_INFLATE_VERIFY_CHECK:
+                if (params[i].size < sizeof(int))
+                    params[i].status = Z_BUF_ERROR;
+                else
+                    *(int *)params[i].buf = (state->wrap & 4) != 0;
+                break;
+            case Z_INFLATE_WINDOW:
+                if (params[i].size < sizeof(int))
+                    params[i].status = Z_BUF_ERROR;
+                else
+                    *(int *)params[i].buf = state->windowless ? Z_INFLATE_WINDOW_OUTPUT : Z_INFLATE_WINDOW_SLIDING;
+                break;
+            case Z_INFLATE_OUTPUT_SIZE:
+                if (params[i].size < sizeof(int64_t))
+                    params[i].status = Z_BUF_ERROR;
+                else
+                    *(int64_t *)params[i].buf = state->outhint;
+                break;
+            case Z_INFLATE_DISCARD:
+                if (params[i].size < sizeof(int))
+                    params[i].status = Z_BUF_ERROR;
+                else
+                    *(int *)params[i].buf = state->discard;
+                break;
+            case Z_INFLATE_STATS:
+                if (params[i].size < sizeof(int))
+                    params[i].status = Z_BUF_ERROR;
+                else
+#ifdef WITH_STATS
+                    *(int *)params[i].buf = state->stats;
+#else
+                    *(int *)params[i].buf = 0;
+#endif
+                break;
+            default:
+                params[i].status = Z_VERSION_ERROR;
+                version_error = 1;
+                break;
+        }
+        if (params[i].status == Z_BUF_ERROR)
+            buf_error = 1;
+    }
+    return buf_error ? Z_BUF_ERROR : (version_error ? Z_VERSION_ERROR : Z_OK);
+}
+
+int32_t Z_EXPORT zng_inflateGetStats(zng_stream *strm, zng_inflate_stats *stats, size_t size) {
+#ifdef WITH_STATS
+    struct inflate_state *state;
+    zng_inflate_stats stat;
+#endif
+
+    if (inflateStateCheck(strm) || stats == NULL)
+        return Z_STREAM_ERROR;
+#ifdef WITH_STATS
+    state = (struct inflate_state *)strm->state;
+    if (!state->stats)
+        return Z_VERSION_ERROR;
+
+    stat = state->stat;
+    stat.slow_bytes -= stat.fast_bytes;
+    memset(stats, 0, size);
+    memcpy(stats, &stat, MIN(size, sizeof(stat)));
+    return Z_OK;
+#else
+    Z_UNUSED(size);
+    return Z_VERSION_ERROR;
+#endif
+}
+#endif
@@ -103,11 +103,18 @@ struct inflate_state {
     uint32_t whave;             /* valid bytes in the window */
     uint32_t wnext;             /* window write index */
     unsigned char *window;      /* allocated sliding window, if needed */
+    uint32_t wbufsize;          /* allocated window size, less than 1 << wbits if
+                                   sized by the output size hint */
+    int windowless;             /* true if history is read from the output buffer */
+    uint32_t dhave;             /* bytes of history before next_out, if windowless */
+    int64_t outhint;            /* expected uncompressed size, or 0 if unknown */
+    int discard;                /* true to decode without writing to next_out */
+    unsigned char *scratch;     /* output buffer used while discarding */
 
     struct crc32_fold_s ALIGNED_(16) crc_fold;
 
         /* bit accumulator */
-    uint32_t hold;              /* input bit accumulator */
+    uint64_t hold;              /* input bit accumulator */
     unsigned bits;              /* number of bits in "in" */
         /* for string and stored block copying */
     uint32_t length;            /* literal or length of data to copy */
@@ -128,13 +135,36 @@ struct inflate_state {
     uint16_t lens[320];         /* temporary storage for code lengths */
     uint16_t work[288];         /* work area for code table building */
     code codes[ENOUGH];         /* space for code tables */
+    code ccodes[1 << 7];        /* code length code table, kept apart so codes[] survives a block */
+        /* last dynamic code tables built in codes[], reused when a block repeats its code lengths */
+    uint32_t treehash;          /* hash of treelens[] */
+    unsigned treelen;           /* number of code lengths in treelens[], zero if none */
+    unsigned treenlen;          /* number of length code lengths in treelens[] */
+    unsigned treelenbits;       /* lenbits of the cached tables */
+    unsigned treedistbits;      /* distbits of the cached tables */
+    uint32_t treedist;          /* offset of the cached distance table in codes[] */
+    uint32_t treeused;          /* number of entries of codes[] used by the cached tables */
+    uint16_t treelens[320];     /* code lengths the cached tables were built from */
     int sane;                   /* if false, allow invalid distance too far */
     int back;                   /* bits back of last unprocessed length/lit */
     unsigned was;               /* initial length of match */
     uint32_t chunksize;         /* size of memory copying chunk */
+#ifdef WITH_STATS
+    int stats;                  /* true to collect statistics */
+    zng_inflate_stats stat;     /* statistics for zng_inflateGetStats(), slow_bytes
+                                   includes fast_bytes until they are returned */
+#endif
 };
 
+/* Count statistics for zng_inflateGetStats() if enabled */
+#ifdef WITH_STATS
+#  define INFLATE_STAT(state, field, n) do { if (UNLIKELY((state)->stats)) (state)->stat.field += (n); } while (0)
+#else
+#  define INFLATE_STAT(state, field, n) do {} while (0)
+#endif
+
 int Z_INTERNAL PREFIX(inflate_ensure_window)(struct inflate_state *state);
+int Z_INTERNAL PREFIX(inflate_windowless)(PREFIX3(stream) *strm);
 void Z_INTERNAL fixedtables(struct inflate_state *state);
 
 #endif /* INFLATE_H_ */
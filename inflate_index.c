@@ -0,0 +1,337 @@
+/* inflate_index.c -- access point index for random access into deflate streams
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * The index is built during a full decompression pass with inflate(Z_BLOCK),
+ * which stops at every deflate block boundary. At boundaries that are at least
+ * span uncompressed bytes apart, the position in the compressed and uncompressed
+ * data is recorded together with the bits of the last byte that still have to
+ * be decoded and the 32K of uncompressed data before the boundary. That is all
+ * a raw inflate needs to resume decompression there, with inflatePrime() and
+ * inflateSetDictionary(). This is the approach of zran.c in the zlib examples.
+ */
+
+#include "zbuild.h"
+#include "zutil.h"
+#include "inftrees.h"
+#include "inflate.h"
+#include "inflate_index.h"
+
+#define INDEX_MAGIC     0x5849475a  /* "ZGIX" */
+#define INDEX_VERSION   1
+#define INDEX_HEAD_SIZE 20          /* magic, version, span, number of access points */
+#define POINT_HEAD_SIZE 24          /* out, in, bits, value, two reserved bytes, wlen */
+
+static void put_32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(v >> (i << 3));
+}
+
+static void put_64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t)(v >> (i << 3));
+}
+
+static uint32_t get_32(const uint8_t *p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++)
+        v |= (uint32_t)p[i] << (i << 3);
+    return v;
+}
+
+static uint64_t get_64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v |= (uint64_t)p[i] << (i << 3);
+    return v;
+}
+
+/* Add an access point for the current position of strm, which must be stopped at a block boundary. */
+static int32_t add_point(PREFIX3(stream) *strm, inflate_index *index) {
+    struct inflate_state *state = (struct inflate_state *)strm->state;
+    inflate_point *point;
+    uint32_t wlen;
+
+    if (index->have == index->size) {
+        uint32_t size = index->size ? index->size << 1 : 8;
+        inflate_point *list = (inflate_point *)realloc(index->list, size * sizeof(inflate_point));
+        if (list == NULL)
+            return Z_MEM_ERROR;
+        index->list = list;
+        index->size = size;
+    }
+
+    point = index->list + index->have;
+    PREFIX(inflateGetDictionary)(strm, NULL, &wlen);
+    point->window = NULL;
+    if (wlen) {
+        point->window = (uint8_t *)malloc(wlen);
+        if (point->window == NULL)
+            return Z_MEM_ERROR;
+        PREFIX(inflateGetDictionary)(strm, point->window, NULL);
+    }
+    point->wlen = wlen;
+    point->out = index->out;
+    /* whole bytes left in the bit buffer are read again when resuming */
+    point->in = index->in - (state->bits >> 3);
+    point->bits = (uint8_t)(state->bits & 7);
+    point->value = (uint8_t)(state->hold & ((1U << point->bits) - 1));
+    index->have++;
+    return Z_OK;
+}
+
+int32_t Z_INTERNAL inflate_index_init(inflate_index **index, int64_t span) {
+    inflate_index *idx;
+
+    if (index == NULL || span <= 0)
+        return Z_STREAM_ERROR;
+    idx = (inflate_index *)calloc(1, sizeof(inflate_index));
+    if (idx == NULL)
+        return Z_MEM_ERROR;
+    idx->span = span;
+    *index = idx;
+    return Z_OK;
+}
+
+int32_t Z_INTERNAL inflate_index_build(PREFIX3(stream) *strm, int32_t flush, inflate_index *index) {
+    uint32_t avail_in, avail_out;
+    uint32_t start_in, start_out;
+    int32_t ret;
+
+    if (strm == NULL || index == NULL)
+        return Z_STREAM_ERROR;
+
+    start_in = strm->avail_in;
+    start_out = strm->avail_out;
+    for (;;) {
+        avail_in = strm->avail_in;
+        avail_out = strm->avail_out;
+        ret = PREFIX(inflate)(strm, Z_BLOCK);
+        index->in += avail_in - strm->avail_in;
+        index->out += avail_out - strm->avail_out;
+        if (ret != Z_OK)
+            break;
+
+        /* at a block boundary that is not the end of the stream */
+        if ((strm->data_type & 128) && !(strm->data_type & 64) &&
+            (index->have == 0 || index->out - index->list[index->have - 1].out >= index->span)) {
+            ret = add_point(strm, index);
+            if (ret != Z_OK)
+                return ret;
+        }
+        if (strm->avail_in == 0 || strm->avail_out == 0)
+            break;
+    }
+
+    /* report progress the same way inflate() does for the requested flush */
+    if (ret == Z_BUF_ERROR && (start_in != strm->avail_in || start_out != strm->avail_out))
+        ret = Z_OK;
+    if (ret == Z_OK && flush == Z_FINISH)
+        ret = Z_BUF_ERROR;
+    return ret;
+}
+
+const inflate_point Z_INTERNAL *inflate_index_find(const inflate_index *index, int64_t offset) {
+    uint32_t lo, hi, mid;
+
+    if (index == NULL || index->have == 0 || offset < 0)
+        return NULL;
+
+    /* find the last access point at or before offset */
+    lo = 0;
+    hi = index->have - 1;
+    while (lo < hi) {
+        mid = hi - ((hi - lo) >> 1);
+        if (index->list[mid].out <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return index->list + lo;
+}
+
+int32_t Z_INTERNAL inflate_index_resume(PREFIX3(stream) *strm, const inflate_point *point) {
+    int32_t ret;
+
+    ret = PREFIX(inflateReset2)(strm, -MAX_WBITS);
+    if (ret != Z_OK)
+        return ret;
+    if (point->bits) {
+        ret = PREFIX(inflatePrime)(strm, point->bits, point->value);
+        if (ret != Z_OK)
+            return ret;
+    }
+    if (point->wlen)
+        ret = PREFIX(inflateSetDictionary)(strm, point->window, point->wlen);
+    return ret;
+}
+
+int32_t Z_INTERNAL inflate_index_seek(PREFIX3(stream) *strm, const inflate_index *index, int64_t offset,
+                                      int64_t *in, int64_t *out) {
+    const inflate_point *point;
+    int32_t ret;
+
+    if (strm == NULL)
+        return Z_STREAM_ERROR;
+    point = inflate_index_find(index, offset);
+    if (point == NULL)
+        return Z_STREAM_ERROR;
+
+    ret = inflate_index_resume(strm, point);
+    if (ret != Z_OK)
+        return ret;
+    if (in != NULL)
+        *in = point->in;
+    if (out != NULL)
+        *out = point->out;
+    return Z_OK;
+}
+
+int32_t Z_INTERNAL inflate_index_save(const inflate_index *index, uint8_t *buf, size_t *len) {
+    const inflate_point *point;
+    size_t size;
+    uint32_t i;
+
+    if (index == NULL || len == NULL)
+        return Z_STREAM_ERROR;
+
+    size = INDEX_HEAD_SIZE;
+    for (i = 0; i < index->have; i++)
+        size += POINT_HEAD_SIZE + index->list[i].wlen;
+    if (buf == NULL) {
+        *len = size;
+        return Z_OK;
+    }
+    if (*len < size) {
+        *len = size;
+        return Z_BUF_ERROR;
+    }
+    *len = size;
+
+    put_32(buf, INDEX_MAGIC);
+    put_32(buf + 4, INDEX_VERSION);
+    put_64(buf + 8, (uint64_t)index->span);
+    put_32(buf + 16, index->have);
+    buf += INDEX_HEAD_SIZE;
+    for (i = 0; i < index->have; i++) {
+        point = index->list + i;
+        put_64(buf, (uint64_t)point->out);
+        put_64(buf + 8, (uint64_t)point->in);
+        buf[16] = point->bits;
+        buf[17] = point->value;
+        buf[18] = 0;
+        buf[19] = 0;
+        put_32(buf + 20, point->wlen);
+        buf += POINT_HEAD_SIZE;
+        if (point->wlen) {
+            memcpy(buf, point->window, point->wlen);
+            buf += point->wlen;
+        }
+    }
+    return Z_OK;
+}
+
+int32_t Z_INTERNAL inflate_index_load(inflate_index **index, const uint8_t *buf, size_t len) {
+    inflate_index *idx;
+    inflate_point *point;
+    int64_t span;
+    uint32_t have, i;
+    int32_t ret;
+
+    if (index == NULL || buf == NULL)
+        return Z_STREAM_ERROR;
+    if (len < INDEX_HEAD_SIZE || get_32(buf) != INDEX_MAGIC || get_32(buf + 4) != INDEX_VERSION)
+        return Z_DATA_ERROR;
+    span = (int64_t)get_64(buf + 8);
+    have = get_32(buf + 16);
+    if (span <= 0 || have > (len - INDEX_HEAD_SIZE) / POINT_HEAD_SIZE)
+        return Z_DATA_ERROR;
+    buf += INDEX_HEAD_SIZE;
+    len -= INDEX_HEAD_SIZE;
+
+    ret = inflate_index_init(&idx, span);
+    if (ret != Z_OK)
+        return ret;
+    if (have) {
+        idx->list = (inflate_point *)calloc(have, sizeof(inflate_point));
+        if (idx->list == NULL) {
+            inflate_index_end(idx);
+            return Z_MEM_ERROR;
+        }
+        idx->size = have;
+    }
+
+    for (i = 0; i < have; i++) {
+        point = idx->list + i;
+        if (len < POINT_HEAD_SIZE)
+            break;
+        point->out = (int64_t)get_64(buf);
+        point->in = (int64_t)get_64(buf + 8);
+        point->bits = buf[16];
+        point->value = buf[17];
+        point->wlen = get_32(buf + 20);
+        buf += POINT_HEAD_SIZE;
+        len -= POINT_HEAD_SIZE;
+        if (point->out < 0 || point->in < 0 || point->bits > 7 || point->wlen > (1U << MAX_WBITS) ||
+            point->wlen > len || point->wlen > point->out ||
+            (i && (point->out <= point[-1].out || point->in < point[-1].in)))
+            break;
+        if (point->wlen) {
+            point->window = (uint8_t *)malloc(point->wlen);
+            if (point->window == NULL) {
+                inflate_index_end(idx);
+                return Z_MEM_ERROR;
+            }
+            memcpy(point->window, buf, point->wlen);
+            buf += point->wlen;
+            len -= point->wlen;
+        }
+        idx->have++;
+    }
+    if (i != have || len != 0) {
+        inflate_index_end(idx);
+        return Z_DATA_ERROR;
+    }
+    *index = idx;
+    return Z_OK;
+}
+
+void Z_INTERNAL inflate_index_end(inflate_index *index) {
+    uint32_t i;
+
+    if (index == NULL)
+        return;
+    for (i = 0; i < index->have; i++)
+        free(index->list[i].window);
+    free(index->list);
+    free(index);
+}
+
+#ifndef ZLIB_COMPAT
+int32_t Z_EXPORT zng_inflateIndexInit(zng_inflate_index **index, int64_t span) {
+    return inflate_index_init(index, span);
+}
+
+int32_t Z_EXPORT zng_inflateIndexBuild(zng_stream *strm, int32_t flush, zng_inflate_index *index) {
+    return inflate_index_build(strm, flush, index);
+}
+
+int32_t Z_EXPORT zng_inflateIndexSeek(zng_stream *strm, const zng_inflate_index *index, int64_t offset,
+                                      int64_t *in, int64_t *out) {
+    return inflate_index_seek(strm, index, offset, in, out);
+}
+
+int32_t Z_EXPORT zng_inflateIndexSave(const zng_inflate_index *index, uint8_t *buf, size_t *len) {
+    return inflate_index_save(index, buf, len);
+}
+
+int32_t Z_EXPORT zng_inflateIndexLoad(zng_inflate_index **index, const uint8_t *buf, size_t len) {
+    return inflate_index_load(index, buf, len);
+}
+
+int32_t Z_EXPORT zng_inflateIndexEnd(zng_inflate_index *index) {
+    if (index == NULL)
+        return Z_STREAM_ERROR;
+    inflate_index_end(index);
+    return Z_OK;
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef INFLATE_INDEX_H_
+#define INFLATE_INDEX_H_
+
+/* inflate_index.h -- header to use inflate_index.c
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+/* Access point, a deflate block boundary at which decompression can be resumed */
+typedef struct inflate_point_s {
+    int64_t out;                /* offset in the uncompressed data */
+    int64_t in;                 /* offset in the compressed data of the first whole byte */
+    uint8_t bits;               /* number of bits (0-7) of the byte before in still to be decoded */
+    uint8_t value;              /* those bits, as passed to inflatePrime() */
+    uint32_t wlen;              /* number of bytes in window */
+    uint8_t *window;            /* uncompressed data preceding the access point, up to 32K */
+} inflate_point;
+
+typedef struct zng_inflate_index_s {
+    int64_t span;               /* minimum uncompressed distance between access points */
+    int64_t in;                 /* compressed bytes consumed while building the index */
+    int64_t out;                /* uncompressed bytes produced while building the index */
+    uint32_t have;              /* number of access points in list */
+    uint32_t size;              /* number of access points allocated in list */
+    inflate_point *list;        /* access points, ordered by offset */
+} inflate_index;
+
+int32_t Z_INTERNAL inflate_index_init(inflate_index **index, int64_t span);
+int32_t Z_INTERNAL inflate_index_build(PREFIX3(stream) *strm, int32_t flush, inflate_index *index);
+const inflate_point Z_INTERNAL *inflate_index_find(const inflate_index *index, int64_t offset);
+int32_t Z_INTERNAL inflate_index_resume(PREFIX3(stream) *strm, const inflate_point *point);
+int32_t Z_INTERNAL inflate_index_seek(PREFIX3(stream) *strm, const inflate_index *index, int64_t offset,
+                                      int64_t *in, int64_t *out);
+int32_t Z_INTERNAL inflate_index_save(const inflate_index *index, uint8_t *buf, size_t *len);
+int32_t Z_INTERNAL inflate_index_load(inflate_index **index, const uint8_t *buf, size_t len);
+void Z_INTERNAL inflate_index_end(inflate_index *index);
+
+#endif
@@ -94,6 +94,18 @@
         bits = 0; \
     } while (0)
 
+/* Load 64 bits from IN and place the bytes at offset BITS in the result. */
+static inline uint64_t load_64_bits(const unsigned char *in, unsigned bits) {
+    uint64_t chunk;
+    memcpy(&chunk, in, sizeof(chunk));
+
+#if BYTE_ORDER == LITTLE_ENDIAN
+    return chunk << bits;
+#else
+    return ZSWAP64(chunk) << bits;
+#endif
+}
+
 /* Ensure that there is at least n bits in the bit accumulator.  If there is
    not enough available input to do that, then return from inflate()/inflateBack(). */
 #define NEEDBITS(n) \
@@ -102,9 +114,43 @@
             PULLBYTE(); \
     } while (0)
 
+/* Fill the bit accumulator with as many whole bytes as fit in 64 bits using a
+   single load when at least eight bytes of input are available, otherwise get
+   one byte with PULLBYTE().  This reads ahead of the bits that are needed, so
+   it is only used while decoding a block and the caller hands the unused whole
+   bytes back with UNPULLBYTES() at the end of the block. */
+#define PULLBITS() \
+    do { \
+        if (have >= 8) { \
+            hold |= load_64_bits(next, bits); \
+            next += (63 ^ bits) >> 3; \
+            have -= (63 ^ bits) >> 3; \
+            bits |= 56; \
+            hold &= (UINT64_C(1) << bits) - 1; \
+        } else { \
+            PULLBYTE(); \
+        } \
+    } while (0)
+
+/* Like NEEDBITS(), but reading ahead with PULLBITS() */
+#define FILLBITS(n) \
+    do { \
+        while (bits < (unsigned)(n)) \
+            PULLBITS(); \
+    } while (0)
+
+/* Return n whole bytes from the top of the bit accumulator to the input */
+#define UNPULLBYTES(n) \
+    do { \
+        next -= (n); \
+        have += (n); \
+        bits -= (unsigned)(n) << 3; \
+        hold &= (UINT64_C(1) << bits) - 1; \
+    } while (0)
+
 /* Return the low n bits of the bit accumulator (n < 16) */
 #define BITS(n) \
-    (hold & ((1U << (unsigned)(n)) - 1))
+    ((unsigned)hold & ((1U << (unsigned)(n)) - 1))
 
 /* Remove n bits from the bit accumulator */
 #define DROPBITS(n) \
@@ -113,6 +159,15 @@
         bits -= (unsigned)(n); \
     } while (0)
 
+/* Reduce a literal pair entry from a literal/length root table to the entry of
+   its first literal, so it can be decoded one symbol at a time */
+#define UNPAIR(here) \
+    do { \
+        here.bits = here.op & 15; \
+        here.op = 0; \
+        here.val &= 0xff; \
+    } while (0)
+
 /* Remove zero to seven bits as needed to go to a byte boundary */
 #define BYTEBITS() \
     do { \
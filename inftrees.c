@@ -17,6 +17,35 @@ const char PREFIX(inflate_copyright)[] = " inflate 1.2.12 Copyright 1995-2022 Ma
   copyright string in the executable of your product.
  */
 
+/*
+   Replace the entries in the literal/length root table whose index bits hold
+   two complete literal codes with a literal pair entry, so that inflate_fast()
+   can write both literals with a single table lookup.  The table is processed
+   from the last index down since the second literal of the entry at index idx
+   is looked up at index idx >> len, which must still hold the original entry.
+ */
+static void pair_literals(code *table, unsigned root) {
+    unsigned idx;               /* root table index */
+    unsigned len;               /* length of the first literal code */
+    code here;                  /* entry for the first literal */
+    code second;                /* entry for the second literal */
+
+    idx = 1U << root;
+    while (idx-- != 0) {
+        here = table[idx];
+        if (here.op != 0 || here.bits >= root)
+            continue;
+        len = here.bits;
+        second = table[idx >> len];
+        if (second.op != 0 || len + second.bits > root)
+            continue;
+        here.op = (unsigned char)(128 + len);
+        here.bits = (unsigned char)(len + second.bits);
+        here.val = (uint16_t)(here.val | (second.val << 8));
+        table[idx] = here;
+    }
+}
+
 /*
    Build a set of tables to decode the provided canonical Huffman code.
    The code lengths are lens[0..codes-1].  The result starts at *table,
@@ -27,7 +56,8 @@ const char PREFIX(inflate_copyright)[] = " inflate 1.2.12 Copyright 1995-2022 Ma
    on return points to the next available entry's address.  bits is the
    requested root table index bits, and on return it is the actual root
    table index bits.  It will differ if the request is greater than the
-   longest code or if it is less than the shortest code.
+   longest code or if it is less than the shortest code.  For LENS, the root
+   table may contain literal pair entries, see inftrees.h.
  */
 int Z_INTERNAL zng_inflate_table(codetype type, uint16_t *lens, unsigned codes,
                                 code * *table, unsigned *bits, uint16_t *work) {
@@ -290,6 +320,10 @@ int Z_INTERNAL zng_inflate_table(codetype type, uint16_t *lens, unsigned codes,
         next[huff] = here;
     }
 
+    /* decode two short literals with one lookup where possible */
+    if (type == LENS)
+        pair_literals(*table, root);
+
     /* set return parameters */
     *table += used;
     *bits = root;
@@ -36,6 +36,12 @@ typedef struct {
     0001eeee - length or distance, eeee is the number of extra bits
     01100000 - end of block
     01000000 - invalid code
+    1000llll - literal pair, llll is the number of bits in the first literal
+
+   Literal pairs only appear in the root table of literal/length codes.  They
+   are used when the root index bits left over by a literal hold a complete
+   second literal code.  bits is then the total length of both codes, and the
+   low and high bytes of val are the first and second literal.
  */
 
 /* Maximum size of the dynamic table.  The maximum number of code structures is
@@ -11,6 +11,7 @@
 #include "zbuild.h"
 #include "deflate.h"
 #include "functable.h"
+#include "deflate_params_tpl.h"
 
 #ifndef MATCH_TPL_H
 #define MATCH_TPL_H
@@ -29,7 +30,7 @@
  */
 Z_INTERNAL uint32_t LONGEST_MATCH(deflate_state *const s, Pos cur_match) {
     unsigned int strstart = s->strstart;
-    const unsigned wmask = s->w_mask;
+    const unsigned wmask = DEFLATE_W_MASK(s);
     unsigned char *window = s->window;
     unsigned char *scan = window + strstart;
     Z_REGISTER unsigned char *mbase_start = window;
@@ -86,15 +87,16 @@ Z_INTERNAL uint32_t LONGEST_MATCH(deflate_state *const s, Pos cur_match) {
     mbase_end  = (mbase_start+offset);
 
     /* Do not waste too much time if we already have a good match */
-    chain_length = s->max_chain_length;
-    if (best_len >= s->good_match)
+    chain_length = DEFLATE_MAX_CHAIN(s);
+    if (best_len >= DEFLATE_GOOD_MATCH(s))
         chain_length >>= 2;
-    nice_match = (uint32_t)s->nice_match;
+    nice_match = (uint32_t)DEFLATE_NICE_MATCH(s);
+    DEFLATE_STAT_SEARCH(s);
 
     /* Stop when cur_match becomes <= limit. To simplify the code,
      * we prevent matches with the string of window index 0
      */
-    limit = strstart > MAX_DIST(s) ? (Pos)(strstart - MAX_DIST(s)) : 0;
+    limit = strstart > DEFLATE_MAX_DIST(s) ? (Pos)(strstart - DEFLATE_MAX_DIST(s)) : 0;
 #ifdef LONGEST_MATCH_SLOW
     limit_base = limit;
     if (best_len >= STD_MIN_MATCH) {
@@ -128,12 +130,13 @@ Z_INTERNAL uint32_t LONGEST_MATCH(deflate_state *const s, Pos cur_match) {
         mbase_end -= match_offset;
     }
 #else
-    early_exit = s->level < EARLY_EXIT_TRIGGER_LEVEL;
+    early_exit = DEFLATE_LEVEL(s) < EARLY_EXIT_TRIGGER_LEVEL;
 #endif
     Assert((unsigned long)strstart <= s->window_size - MIN_LOOKAHEAD, "need lookahead");
     for (;;) {
         if (cur_match >= strstart)
             break;
+        DEFLATE_STAT_STEP(s);
 
         /* Skip to next match if the match length cannot increase or if the match length is
          * less than 2. Note that the checks below for insufficient lookahead only occur
@@ -0,0 +1,260 @@
+/* benchmark_corpus.cc -- benchmark deflate and inflate over corpus files per level, strategy and buffer size
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <dirent.h>
+#  include <sys/stat.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+extern "C" {
+#  include "zbuild.h"
+#  include "zutil.h"
+}
+
+#ifdef _WIN32
+#  define CORPUS_PATH_SEP ';'
+#else
+#  define CORPUS_PATH_SEP ':'
+#endif
+
+#define CORPUS_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+/* The level that strategies which do not depend on it are run with */
+#define CORPUS_FLAT_LEVEL 6
+
+typedef struct corpus_file_s {
+    std::string name;
+    uint8_t *data;
+    size_t size;
+} corpus_file;
+
+typedef struct corpus_strategy_s {
+    const char *name;
+    int32_t strategy;
+} corpus_strategy;
+
+static const corpus_strategy corpus_strategies[] = {
+    { "default", Z_DEFAULT_STRATEGY },
+    { "filtered", Z_FILTERED },
+    { "huffman", Z_HUFFMAN_ONLY },
+    { "rle", Z_RLE },
+    { "fixed", Z_FIXED }
+};
+
+/* Buffer sizes handed to each deflate and inflate call for input and output, 0 passes the whole stream at once */
+static const int64_t corpus_buffer_sizes[] = { 4096, 65536, 0 };
+
+static std::vector<corpus_file> corpus;
+
+static void corpus_add_file(const std::string &path, const std::string &name) {
+    FILE *f = fopen(path.c_str(), "rb");
+    corpus_file file;
+    long size;
+
+    if (f == NULL)
+        return;
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return;
+    }
+    file.name = name;
+    file.size = (size_t)size;
+    file.data = (uint8_t *)malloc(file.size);
+    if (file.data == NULL || fread(file.data, 1, file.size, f) != file.size) {
+        fprintf(stderr, "corpus: cannot read %s\n", path.c_str());
+        free(file.data);
+        fclose(f);
+        return;
+    }
+    fclose(f);
+    corpus.push_back(file);
+}
+
+/* Adds the regular files in dir, named by the last component of dir and their own name */
+static void corpus_add_dir(const std::string &dir) {
+    std::string prefix = dir.substr(dir.find_last_of("/\\") + 1) + "/";
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &entry);
+
+    if (find == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "corpus: cannot open %s\n", dir.c_str());
+        return;
+    }
+    do {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            corpus_add_file(dir + "\\" + entry.cFileName, prefix + entry.cFileName);
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR *d = opendir(dir.c_str());
+    struct dirent *entry;
+    struct stat st;
+
+    if (d == NULL) {
+        fprintf(stderr, "corpus: cannot open %s\n", dir.c_str());
+        return;
+    }
+    while ((entry = readdir(d)) != NULL) {
+        std::string path = dir + "/" + entry->d_name;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            corpus_add_file(path, prefix + entry->d_name);
+    }
+    closedir(d);
+#endif
+}
+
+/* Compresses file into out, which holds at least deflateBound() bytes, passing at most buf_size bytes of input and
+ * output to each call. Returns the compressed size, or 0 on error.
+ */
+static size_t corpus_compress(const corpus_file &file, int32_t level, int32_t strategy, size_t buf_size,
+                              uint8_t *out, size_t out_size) {
+    PREFIX3(stream) strm;
+    size_t in_pos = 0, len = 0;
+    int32_t err = Z_OK;
+
+    memset(&strm, 0, sizeof(strm));
+    if (PREFIX(deflateInit2)(&strm, level, Z_DEFLATED, MAX_WBITS, 8, strategy) != Z_OK)
+        return 0;
+    if (buf_size == 0)
+        buf_size = MAX(file.size, out_size);
+    strm.next_out = out;
+    while (err == Z_OK) {
+        size_t in_len = MIN(buf_size, file.size - in_pos);
+
+        strm.next_in = file.data + in_pos;
+        strm.avail_in = (uint32_t)in_len;
+        strm.avail_out = (uint32_t)MIN(buf_size, out_size - strm.total_out);
+        err = PREFIX(deflate)(&strm, in_pos + in_len == file.size ? Z_FINISH : Z_NO_FLUSH);
+        in_pos += in_len - strm.avail_in;
+    }
+    if (err == Z_STREAM_END)
+        len = strm.total_out;
+    PREFIX(deflateEnd)(&strm);
+    return len;
+}
+
+/* Decompresses len bytes of compr into out, which holds file.size bytes, buf_size bytes at a time */
+static bool corpus_uncompress(const corpus_file &file, uint8_t *compr, size_t len, size_t buf_size,
+                              uint8_t *out) {
+    PREFIX3(stream) strm;
+    size_t in_pos = 0;
+    int32_t err = Z_OK;
+
+    memset(&strm, 0, sizeof(strm));
+    if (PREFIX(inflateInit2)(&strm, MAX_WBITS) != Z_OK)
+        return false;
+    if (buf_size == 0)
+        buf_size = MAX(file.size, len);
+    strm.next_out = out;
+    while (err == Z_OK) {
+        size_t in_len = MIN(buf_size, len - in_pos);
+
+        strm.next_in = compr + in_pos;
+        strm.avail_in = (uint32_t)in_len;
+        strm.avail_out = (uint32_t)MIN(buf_size, file.size - strm.total_out);
+        err = PREFIX(inflate)(&strm, Z_NO_FLUSH);
+        in_pos += in_len - strm.avail_in;
+    }
+    PREFIX(inflateEnd)(&strm);
+    return err == Z_STREAM_END && strm.total_out == file.size;
+}
+
+static void corpus_deflate(benchmark::State& state, size_t index, int32_t strategy) {
+    const corpus_file &file = corpus[index];
+    size_t out_size = PREFIX(compressBound)(file.size) + 64;
+    uint8_t *out = (uint8_t *)malloc(out_size);
+    size_t len = 0;
+
+    for (auto _ : state) {
+        len = corpus_compress(file, (int32_t)state.range(0), strategy, (size_t)state.range(1), out, out_size);
+        if (len == 0) {
+            state.SkipWithError("deflate failed");
+            break;
+        }
+    }
+    free(out);
+    state.SetBytesProcessed(state.iterations() * file.size);
+    state.counters["ratio"] = (double)file.size / (len ? len : 1);
+}
+
+static void corpus_inflate(benchmark::State& state, size_t index, int32_t strategy) {
+    const corpus_file &file = corpus[index];
+    size_t compr_size = PREFIX(compressBound)(file.size) + 64;
+    uint8_t *compr = (uint8_t *)malloc(compr_size);
+    uint8_t *out = (uint8_t *)malloc(file.size);
+    size_t len = corpus_compress(file, (int32_t)state.range(0), strategy, 0, compr, compr_size);
+
+    if (len == 0)
+        state.SkipWithError("deflate failed");
+    for (auto _ : state) {
+        if (len == 0 || !corpus_uncompress(file, compr, len, (size_t)state.range(1), out)) {
+            state.SkipWithError("inflate failed");
+            break;
+        }
+    }
+    free(out);
+    free(compr);
+    state.SetBytesProcessed(state.iterations() * file.size);
+    state.counters["ratio"] = (double)file.size / (len ? len : 1);
+}
+
+/* Registers corpus/<file>/{deflate,inflate}/<strategy>/level:<n>/buf:<size> for the files in test/data, and for the
+ * files in the directories listed in ZLIBNG_BENCH_CORPUS, separated by ':' (';' on Windows). Combinations that run
+ * the same code are left out: level 0 stores whatever the strategy, and huffman and rle do not depend on the level.
+ */
+static int register_corpus_benchmarks(void) {
+    static const char *data_files[] = { "lcet10.txt", "paper-100k.pdf", "fireworks.jpg" };
+    const char *dirs = getenv("ZLIBNG_BENCH_CORPUS");
+
+    for (size_t i = 0; i < CORPUS_COUNT(data_files); i++)
+        corpus_add_file(std::string(BENCHMARK_DATA_DIR) + "/" + data_files[i], data_files[i]);
+    if (dirs != NULL) {
+        std::string list = dirs;
+        size_t start = 0, end;
+
+        do {
+            end = list.find(CORPUS_PATH_SEP, start);
+            std::string dir = list.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            if (!dir.empty())
+                corpus_add_dir(dir);
+            start = end + 1;
+        } while (end != std::string::npos);
+    }
+
+    for (size_t i = 0; i < corpus.size(); i++) {
+        for (size_t s = 0; s < CORPUS_COUNT(corpus_strategies); s++) {
+            const corpus_strategy &strategy = corpus_strategies[s];
+            int32_t strategy_flat = strategy.strategy == Z_HUFFMAN_ONLY || strategy.strategy == Z_RLE;
+
+            for (int d = 0; d < 2; d++) {
+                std::string name = "corpus/" + corpus[i].name + (d ? "/inflate/" : "/deflate/") + strategy.name;
+                benchmark::internal::Benchmark *bench = benchmark::RegisterBenchmark(name.c_str(),
+                    d ? corpus_inflate : corpus_deflate, i, strategy.strategy);
+
+                bench->ArgNames({"level", "buf"})->Unit(benchmark::kMillisecond);
+                for (int64_t level = 0; level <= 9; level++) {
+                    if ((level == 0 && strategy.strategy != Z_DEFAULT_STRATEGY) ||
+                        (strategy_flat && level != CORPUS_FLAT_LEVEL))
+                        continue;
+                    for (size_t b = 0; b < CORPUS_COUNT(corpus_buffer_sizes); b++)
+                        bench->Args({level, corpus_buffer_sizes[b]});
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int corpus_registered = register_corpus_benchmarks();
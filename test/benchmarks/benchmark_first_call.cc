@@ -0,0 +1,70 @@
+/* benchmark_first_call.cc -- benchmark the first zlib calls made by a fresh thread
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include <string.h>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+extern "C" {
+#  include "zbuild.h"
+#  include "zutil.h"
+}
+
+#define FIRST_CALL_SIZE 256
+
+static uint8_t first_call_data[FIRST_CALL_SIZE];
+
+/* Every iteration starts a thread that makes its first call, so the difference to the "thread" benchmark is what a
+ * new connection thread pays before its first checksum or stream is done.
+ */
+static void first_call_thread(benchmark::State& state) {
+    for (auto _ : state) {
+        std::thread thread([] { benchmark::ClobberMemory(); });
+        thread.join();
+    }
+}
+BENCHMARK(first_call_thread);
+
+static void first_call_adler32(benchmark::State& state) {
+    for (auto _ : state) {
+        std::thread thread([] {
+            benchmark::DoNotOptimize(PREFIX(adler32)(1, first_call_data, FIRST_CALL_SIZE));
+        });
+        thread.join();
+    }
+}
+BENCHMARK(first_call_adler32);
+
+static void first_call_crc32(benchmark::State& state) {
+    for (auto _ : state) {
+        std::thread thread([] {
+            benchmark::DoNotOptimize(PREFIX(crc32)(0, first_call_data, FIRST_CALL_SIZE));
+        });
+        thread.join();
+    }
+}
+BENCHMARK(first_call_crc32);
+
+static void first_call_deflate(benchmark::State& state) {
+    for (auto _ : state) {
+        std::thread thread([] {
+            uint8_t out[FIRST_CALL_SIZE * 2];
+            PREFIX3(stream) strm;
+
+            memset(&strm, 0, sizeof(strm));
+            if (PREFIX(deflateInit)(&strm, Z_DEFAULT_COMPRESSION) != Z_OK)
+                return;
+            strm.next_in = first_call_data;
+            strm.avail_in = FIRST_CALL_SIZE;
+            strm.next_out = out;
+            strm.avail_out = sizeof(out);
+            PREFIX(deflate)(&strm, Z_FINISH);
+            PREFIX(deflateEnd)(&strm);
+            benchmark::DoNotOptimize(out);
+        });
+        thread.join();
+    }
+}
+BENCHMARK(first_call_deflate);
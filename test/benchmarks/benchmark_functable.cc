@@ -0,0 +1,114 @@
+/* benchmark_functable.cc -- benchmark deflate and inflate with every variant of every functable entry
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include <stdio.h>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+extern "C" {
+#  include "zbuild.h"
+#  include "zlib-ng.h"
+}
+
+#include "test_shared.h"
+
+#define BENCH_SIZE (1024 * 1024)
+
+class functable_data {
+public:
+    uint8_t *data;
+    uint8_t *compr;
+    uint8_t *uncompr;
+    size_t compr_size;
+
+    functable_data() {
+        data = (uint8_t *)malloc(BENCH_SIZE);
+        uncompr = (uint8_t *)malloc(BENCH_SIZE);
+        compr_size = zng_compressBound(BENCH_SIZE) + 32;
+        compr = (uint8_t *)malloc(compr_size);
+        gen_backref_text(data, BENCH_SIZE, 1, 4096, 4096);
+    }
+
+    ~functable_data() {
+        free(compr);
+        free(uncompr);
+        free(data);
+    }
+
+    /* Returns the compressed size, or 0 on error */
+    size_t compress(int32_t level, int32_t window_bits) {
+        return compress_buffer(data, BENCH_SIZE, compr, compr_size, level, window_bits);
+    }
+
+    bool uncompress(size_t len, int32_t window_bits) {
+        return uncompress_buffer(compr, len, uncompr, BENCH_SIZE, window_bits) == BENCH_SIZE;
+    }
+};
+
+static functable_data *bench_data;
+
+/* The crc32 entries are only used with a gzip wrapper */
+static int32_t window_bits(const std::string &entry) {
+    return entry.compare(0, 5, "crc32") == 0 ? MAX_WBITS + 16 : MAX_WBITS;
+}
+
+static void functable_deflate(benchmark::State& state, std::string entry, std::string variant) {
+    size_t len = 0;
+
+    if (zng_functable_select(entry.c_str(), variant.c_str()) != Z_OK) {
+        state.SkipWithError("variant not available");
+        return;
+    }
+    for (auto _ : state) {
+        len = bench_data->compress((int32_t)state.range(0), window_bits(entry));
+        if (len == 0) {
+            state.SkipWithError("deflate failed");
+            break;
+        }
+    }
+    zng_functable_select(entry.c_str(), NULL);
+    state.SetBytesProcessed(state.iterations() * BENCH_SIZE);
+    state.counters["ratio"] = (double)BENCH_SIZE / (len ? len : 1);
+}
+
+static void functable_inflate(benchmark::State& state, std::string entry, std::string variant) {
+    size_t len;
+
+    if (zng_functable_select(entry.c_str(), variant.c_str()) != Z_OK) {
+        state.SkipWithError("variant not available");
+        return;
+    }
+    len = bench_data->compress(6, window_bits(entry));
+    for (auto _ : state) {
+        if (!bench_data->uncompress(len, window_bits(entry))) {
+            state.SkipWithError("inflate failed");
+            break;
+        }
+    }
+    zng_functable_select(entry.c_str(), NULL);
+    state.SetBytesProcessed(state.iterations() * BENCH_SIZE);
+}
+
+/* Registers functable/<entry>/<variant>/deflate and /inflate for every variant the CPU can run, so that e.g.
+ * --benchmark_filter=functable/longest_match compares all longest_match implementations within whole streams.
+ */
+static int register_functable_benchmarks(void) {
+    const char *entry, *variant;
+
+    bench_data = new functable_data();
+    for (int32_t i = 0; (entry = zng_functable_entry(i)) != NULL; i++) {
+        for (int32_t j = 0; (variant = zng_functable_variant(entry, j)) != NULL; j++) {
+            std::string name = std::string("functable/") + entry + "/" + variant;
+
+            benchmark::RegisterBenchmark((name + "/deflate").c_str(), functable_deflate, entry, variant)
+                ->Arg(1)->Arg(6)->Arg(9)->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark((name + "/inflate").c_str(), functable_inflate, entry, variant)
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+    return 0;
+}
+
+static int functable_registered = register_functable_benchmarks();
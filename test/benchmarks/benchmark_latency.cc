@@ -0,0 +1,304 @@
+/* benchmark_latency.cc -- benchmark the latency of small messages compressed with Z_SYNC_FLUSH
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+extern "C" {
+#  include "zbuild.h"
+#  include "zutil.h"
+}
+
+#define LATENCY_MESSAGES 1024
+#define LATENCY_MAX_SIZE 8192
+#define LATENCY_LEVEL    6
+
+/* How the streams are used from one message to the next */
+typedef enum latency_mode_e {
+    LATENCY_STREAM,  /* one stream for all messages, as with context takeover */
+    LATENCY_RESET,   /* deflateReset() or inflateReset() before each message */
+    LATENCY_CHURN    /* a new stream for each message, from deflateInit2() to deflateEnd() */
+} latency_mode;
+
+typedef struct latency_alloc_s {
+    uint64_t allocs;
+    uint64_t bytes;
+} latency_alloc;
+
+/* Counts the allocations and their sizes, since they are part of the latency when streams are not reused */
+static void *latency_zalloc(void *opaque, unsigned int items, unsigned int size) {
+    latency_alloc *counts = (latency_alloc *)opaque;
+
+    counts->allocs++;
+    counts->bytes += (uint64_t)items * size;
+    return malloc((size_t)items * size);
+}
+
+static void latency_zfree(void *opaque, void *ptr) {
+    Z_UNUSED(opaque);
+    free(ptr);
+}
+
+class latency_data {
+public:
+    std::vector<std::string> messages;
+    std::string dict;
+
+    /* Messages are JSON records with a fixed set of keys and varying values, cut to the message size, which is the
+     * kind of data that dictionaries are made for. The dictionary holds records made with another seed.
+     */
+    latency_data(size_t size) {
+        uint32_t seed = 1;
+
+        for (int32_t i = 0; i < LATENCY_MESSAGES; i++)
+            messages.push_back(records(&seed, size));
+        seed = 2;
+        dict = records(&seed, 1024);
+    }
+
+    static std::string records(uint32_t *seed, size_t size) {
+        static const char *keys[] = { "id", "user", "timestamp", "status", "method", "path", "latency_ms", "region" };
+        static const char *words[] = { "GET", "POST", "ok", "error", "eu-west", "us-east", "/api/v1/items",
+                                       "/api/v1/users", "alice", "bob", "carol", "pending", "done" };
+        std::string out;
+
+        while (out.size() < size) {
+            out += "{";
+            for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+                *seed = *seed * 1103515245 + 12345;
+                out += std::string(k ? ",\"" : "\"") + keys[k] + "\":";
+                if ((*seed >> 16) % 2)
+                    out += std::to_string((*seed >> 8) % 100000);
+                else
+                    out += std::string("\"") + words[(*seed >> 12) % (sizeof(words) / sizeof(words[0]))] + "\"";
+            }
+            out += "}\n";
+        }
+        return out.substr(0, size);
+    }
+};
+
+/* Reports the percentiles of the latencies of single messages, in microseconds, and the allocations per message */
+static void latency_report(benchmark::State& state, std::vector<double> &ns, const latency_alloc &counts) {
+    static const struct { const char *name; double quantile; } percentiles[] = {
+        { "p50_us", 0.50 }, { "p99_us", 0.99 }, { "p99.9_us", 0.999 }
+    };
+
+    if (ns.empty())
+        return;
+    std::sort(ns.begin(), ns.end());
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        size_t index = MIN((size_t)(percentiles[i].quantile * ns.size()), ns.size() - 1);
+        state.counters[percentiles[i].name] = ns[index] / 1000.0;
+    }
+    state.counters["allocs"] = benchmark::Counter((double)counts.allocs, benchmark::Counter::kAvgIterations);
+    state.counters["alloc_bytes"] = benchmark::Counter((double)counts.bytes, benchmark::Counter::kAvgIterations);
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static int32_t latency_deflate_init(PREFIX3(stream) *strm, const latency_data &data, bool dict) {
+    if (PREFIX(deflateInit2)(strm, LATENCY_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return Z_STREAM_ERROR;
+    if (dict)
+        return PREFIX(deflateSetDictionary)(strm, (const uint8_t *)data.dict.data(), (uint32_t)data.dict.size());
+    return Z_OK;
+}
+
+static int32_t latency_inflate_init(PREFIX3(stream) *strm, const latency_data &data, bool dict) {
+    if (PREFIX(inflateInit2)(strm, -MAX_WBITS) != Z_OK)
+        return Z_STREAM_ERROR;
+    if (dict)
+        return PREFIX(inflateSetDictionary)(strm, (const uint8_t *)data.dict.data(), (uint32_t)data.dict.size());
+    return Z_OK;
+}
+
+static int32_t latency_inflate_restart(PREFIX3(stream) *strm, const latency_data &data, bool dict) {
+    if (PREFIX(inflateReset)(strm) != Z_OK)
+        return Z_STREAM_ERROR;
+    if (dict)
+        return PREFIX(inflateSetDictionary)(strm, (const uint8_t *)data.dict.data(), (uint32_t)data.dict.size());
+    return Z_OK;
+}
+
+/* Compresses one message with Z_SYNC_FLUSH into out, which holds compressBound() + 64 bytes, and returns the
+ * compressed size, or 0 on error
+ */
+static size_t latency_deflate_message(PREFIX3(stream) *strm, const latency_data &data, bool dict, latency_mode mode,
+                                      const std::string &msg, uint8_t *out, size_t out_size) {
+    if (mode == LATENCY_CHURN && latency_deflate_init(strm, data, dict) != Z_OK)
+        return 0;
+    if (mode == LATENCY_RESET) {
+        if (PREFIX(deflateReset)(strm) != Z_OK)
+            return 0;
+        if (dict && PREFIX(deflateSetDictionary)(strm, (const uint8_t *)data.dict.data(),
+                                                 (uint32_t)data.dict.size()) != Z_OK)
+            return 0;
+    }
+    strm->next_in = (uint8_t *)msg.data();
+    strm->avail_in = (uint32_t)msg.size();
+    strm->next_out = out;
+    strm->avail_out = (uint32_t)out_size;
+    if (PREFIX(deflate)(strm, Z_SYNC_FLUSH) != Z_OK || strm->avail_in != 0 || strm->avail_out == 0)
+        return 0;
+    if (mode == LATENCY_CHURN)
+        PREFIX(deflateEnd)(strm);
+    return out_size - strm->avail_out;
+}
+
+static bool latency_inflate_message(PREFIX3(stream) *strm, const latency_data &data, bool dict, latency_mode mode,
+                                    uint8_t *in, size_t len, uint8_t *out, size_t out_size) {
+    if (mode == LATENCY_CHURN && latency_inflate_init(strm, data, dict) != Z_OK)
+        return false;
+    if (mode == LATENCY_RESET && latency_inflate_restart(strm, data, dict) != Z_OK)
+        return false;
+    strm->next_in = in;
+    strm->avail_in = (uint32_t)len;
+    strm->next_out = out;
+    strm->avail_out = (uint32_t)out_size;
+    if (PREFIX(inflate)(strm, Z_SYNC_FLUSH) != Z_OK || strm->avail_in != 0 || strm->avail_out != 0)
+        return false;
+    if (mode == LATENCY_CHURN)
+        PREFIX(inflateEnd)(strm);
+    return true;
+}
+
+static void latency_deflate(benchmark::State& state, latency_mode mode, bool dict) {
+    latency_data data((size_t)state.range(0));
+    size_t out_size = PREFIX(compressBound)(LATENCY_MAX_SIZE) + 64;
+    uint8_t *out = (uint8_t *)malloc(out_size);
+    latency_alloc counts = { 0, 0 };
+    std::vector<double> ns;
+    PREFIX3(stream) strm;
+    size_t i = 0;
+
+    memset(&strm, 0, sizeof(strm));
+    strm.zalloc = latency_zalloc;
+    strm.zfree = latency_zfree;
+    strm.opaque = &counts;
+    if (mode != LATENCY_CHURN && latency_deflate_init(&strm, data, dict) != Z_OK) {
+        state.SkipWithError("deflateInit failed");
+        free(out);
+        return;
+    }
+    counts.allocs = counts.bytes = 0;
+    ns.reserve(1 << 20);
+
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        size_t len = latency_deflate_message(&strm, data, dict, mode, data.messages[i], out, out_size);
+        auto end = std::chrono::steady_clock::now();
+
+        if (len == 0) {
+            state.SkipWithError("deflate failed");
+            break;
+        }
+        double elapsed = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        state.SetIterationTime(elapsed / 1e9);
+        ns.push_back(elapsed);
+        i = (i + 1) % LATENCY_MESSAGES;
+    }
+    if (mode != LATENCY_CHURN)
+        PREFIX(deflateEnd)(&strm);
+    free(out);
+    latency_report(state, ns, counts);
+}
+
+static void latency_inflate(benchmark::State& state, latency_mode mode, bool dict) {
+    latency_data data((size_t)state.range(0));
+    size_t out_size = PREFIX(compressBound)(LATENCY_MAX_SIZE) + 64;
+    uint8_t *compr = (uint8_t *)malloc(out_size * LATENCY_MESSAGES);
+    uint8_t *out = (uint8_t *)malloc(LATENCY_MAX_SIZE);
+    std::vector<size_t> offsets(LATENCY_MESSAGES + 1, 0);
+    latency_alloc counts = { 0, 0 };
+    std::vector<double> ns;
+    PREFIX3(stream) strm;
+    size_t i = 0;
+    bool ok = true;
+
+    /* The messages are compressed the same way they are decompressed, so that with one stream for all of them
+     * they have to be decompressed in order, from the start again after the last one.
+     */
+    memset(&strm, 0, sizeof(strm));
+    ok = mode == LATENCY_CHURN || latency_deflate_init(&strm, data, dict) == Z_OK;
+    for (i = 0; ok && i < LATENCY_MESSAGES; i++) {
+        size_t len = latency_deflate_message(&strm, data, dict, mode, data.messages[i], compr + offsets[i], out_size);
+        offsets[i + 1] = offsets[i] + len;
+        ok = len != 0;
+    }
+    if (mode != LATENCY_CHURN)
+        PREFIX(deflateEnd)(&strm);
+
+    memset(&strm, 0, sizeof(strm));
+    strm.zalloc = latency_zalloc;
+    strm.zfree = latency_zfree;
+    strm.opaque = &counts;
+    if (!ok || (mode != LATENCY_CHURN && latency_inflate_init(&strm, data, dict) != Z_OK)) {
+        state.SkipWithError("setup failed");
+        free(out);
+        free(compr);
+        return;
+    }
+    counts.allocs = counts.bytes = 0;
+    ns.reserve(1 << 20);
+
+    i = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        bool done = latency_inflate_message(&strm, data, dict, mode, compr + offsets[i], offsets[i + 1] - offsets[i],
+                                            out, data.messages[i].size());
+        auto end = std::chrono::steady_clock::now();
+
+        if (!done || memcmp(out, data.messages[i].data(), data.messages[i].size()) != 0) {
+            state.SkipWithError("inflate failed");
+            break;
+        }
+        double elapsed = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        state.SetIterationTime(elapsed / 1e9);
+        ns.push_back(elapsed);
+        i = (i + 1) % LATENCY_MESSAGES;
+        /* rewind a stream that continues from one message to the next, outside of the timed part */
+        if (i == 0 && mode == LATENCY_STREAM && latency_inflate_restart(&strm, data, dict) != Z_OK) {
+            state.SkipWithError("inflateReset failed");
+            break;
+        }
+    }
+    if (mode != LATENCY_CHURN)
+        PREFIX(inflateEnd)(&strm);
+    free(out);
+    free(compr);
+    latency_report(state, ns, counts);
+}
+
+/* Registers latency/<deflate|inflate>/<stream|reset|churn>[/dict]/size:<n>. Each iteration is one message, timed on
+ * its own, and p50_us, p99_us and p99.9_us give the distribution of those times. allocs and alloc_bytes count the
+ * calls to zalloc per message, so they are 0 once a reused stream is set up.
+ */
+static int register_latency_benchmarks(void) {
+    static const struct { const char *name; latency_mode mode; } modes[] = {
+        { "stream", LATENCY_STREAM }, { "reset", LATENCY_RESET }, { "churn", LATENCY_CHURN }
+    };
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        for (int dict = 0; dict < 2; dict++) {
+            std::string name = std::string("/") + modes[m].name + (dict ? "/dict" : "");
+
+            benchmark::RegisterBenchmark(("latency/deflate" + name).c_str(), latency_deflate, modes[m].mode, dict != 0)
+                ->ArgName("size")->Arg(200)->Arg(1024)->Arg(LATENCY_MAX_SIZE)->UseManualTime()
+                ->Unit(benchmark::kMicrosecond);
+            benchmark::RegisterBenchmark(("latency/inflate" + name).c_str(), latency_inflate, modes[m].mode, dict != 0)
+                ->ArgName("size")->Arg(200)->Arg(1024)->Arg(LATENCY_MAX_SIZE)->UseManualTime()
+                ->Unit(benchmark::kMicrosecond);
+        }
+    }
+    return 0;
+}
+
+static int latency_registered = register_latency_benchmarks();
@@ -0,0 +1,124 @@
+/* test_compress_batch.cc - Test zng_compress_batch() and zng_uncompress_batch() */
+
+#include "zbuild.h"
+#include "zlib-ng.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#define ITEM_COUNT 300
+#define ITEM_MAX_SIZE (64 * 1024)
+
+class compress_batch : public testing::TestWithParam<int32_t> {
+public:
+    uint8_t *data = NULL;
+    uint8_t *compr = NULL;
+    uint8_t *uncompr = NULL;
+    zng_batch_item items[ITEM_COUNT];
+    size_t sizes[ITEM_COUNT];
+
+    void SetUp() override {
+        uint32_t seed = 11;
+        size_t offset = 0;
+
+        for (int i = 0; i < ITEM_COUNT; i++) {
+            seed = seed * 1103515245 + 12345;
+            /* mostly small records, a few large ones */
+            sizes[i] = i % 50 == 0 ? ITEM_MAX_SIZE : 1 + (seed >> 16) % 2048;
+            offset += sizes[i];
+        }
+        data = (uint8_t *)malloc(offset);
+        compr = (uint8_t *)malloc(ITEM_COUNT * zng_compressBound(ITEM_MAX_SIZE));
+        uncompr = (uint8_t *)malloc(offset);
+        ASSERT_TRUE(data != NULL && compr != NULL && uncompr != NULL);
+        for (size_t i = 0; i < offset; i++) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = (uint8_t)("abcdefgh,01234: "[(seed >> 16) % 16]);
+        }
+    }
+
+    void TearDown() override {
+        free(uncompr);
+        free(compr);
+        free(data);
+    }
+
+    void compress(int32_t level, int32_t threads) {
+        size_t offset = 0;
+
+        for (int i = 0; i < ITEM_COUNT; i++) {
+            items[i].src = data + offset;
+            items[i].src_len = sizes[i];
+            items[i].dest = compr + i * zng_compressBound(ITEM_MAX_SIZE);
+            items[i].dest_len = zng_compressBound(sizes[i]);
+            offset += sizes[i];
+        }
+        ASSERT_EQ(zng_compress_batch(items, ITEM_COUNT, level, threads), Z_OK);
+    }
+
+    void uncompress(int32_t threads) {
+        size_t offset = 0;
+
+        for (int i = 0; i < ITEM_COUNT; i++) {
+            EXPECT_EQ(items[i].status, Z_OK);
+            items[i].src = items[i].dest;
+            items[i].src_len = items[i].dest_len;
+            items[i].dest = uncompr + offset;
+            items[i].dest_len = sizes[i];
+            offset += sizes[i];
+        }
+        ASSERT_EQ(zng_uncompress_batch(items, ITEM_COUNT, threads), Z_OK);
+        for (int i = 0; i < ITEM_COUNT; i++) {
+            EXPECT_EQ(items[i].status, Z_OK);
+            EXPECT_EQ(items[i].dest_len, sizes[i]);
+        }
+        EXPECT_EQ(memcmp(uncompr, data, offset), 0);
+    }
+};
+
+TEST_P(compress_batch, roundtrip) {
+    int32_t threads = GetParam();
+
+    for (int32_t level = 0; level <= 9; level += 3) {
+        compress(level, threads);
+        /* each item is a complete zlib stream */
+        size_t len = sizes[7];
+        ASSERT_EQ(zng_uncompress(uncompr, &len, items[7].dest, items[7].dest_len), Z_OK);
+        EXPECT_EQ(len, sizes[7]);
+        uncompress(threads);
+    }
+}
+
+TEST_P(compress_batch, errors) {
+    int32_t threads = GetParam();
+    uint8_t small[8];
+
+    compress(Z_DEFAULT_COMPRESSION, threads);
+    /* an output buffer too small, and a corrupted stream, only fail their own items */
+    size_t offset = 0;
+    items[9].dest[items[9].dest_len - 1] ^= 1;
+    for (int i = 0; i < ITEM_COUNT; i++) {
+        items[i].src = items[i].dest;
+        items[i].src_len = items[i].dest_len;
+        items[i].dest = uncompr + offset;
+        items[i].dest_len = sizes[i];
+        offset += sizes[i];
+    }
+    items[5].dest = small;
+    items[5].dest_len = sizeof(small);
+    EXPECT_EQ(zng_uncompress_batch(items, ITEM_COUNT, threads), Z_BUF_ERROR);
+    EXPECT_EQ(items[5].status, Z_BUF_ERROR);
+    EXPECT_EQ(items[9].status, Z_DATA_ERROR);
+    EXPECT_EQ(items[6].status, Z_OK);
+    EXPECT_EQ(items[ITEM_COUNT - 1].status, Z_OK);
+
+    EXPECT_EQ(zng_compress_batch(items, ITEM_COUNT, 10, threads), Z_STREAM_ERROR);
+    EXPECT_EQ(zng_compress_batch(NULL, 1, 6, threads), Z_STREAM_ERROR);
+    EXPECT_EQ(zng_compress_batch(NULL, 0, 6, threads), Z_OK);
+}
+
+INSTANTIATE_TEST_SUITE_P(compress_batch, compress_batch, testing::Values(1, 4));
@@ -0,0 +1,174 @@
+/* test_functable.cc - Test zng_set_cpu_features() and zng_functable_select() */
+
+#include "zbuild.h"
+#include "zlib-ng.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_shared.h"
+
+#include <gtest/gtest.h>
+
+#define DATA_SIZE (300 * 1024)
+
+class functable : public testing::Test {
+public:
+    uint8_t *data = NULL;
+    uint8_t *compr = NULL;
+    uint8_t *uncompr = NULL;
+    size_t compr_size = 0;
+
+    void SetUp() override {
+        data = (uint8_t *)malloc(DATA_SIZE);
+        uncompr = (uint8_t *)malloc(DATA_SIZE);
+        compr_size = zng_compressBound(DATA_SIZE) + 32;
+        compr = (uint8_t *)malloc(compr_size);
+        ASSERT_TRUE(data != NULL && uncompr != NULL && compr != NULL);
+        gen_backref_text(data, DATA_SIZE, 7, 300, 300);
+    }
+
+    void TearDown() override {
+        for (int32_t i = 0; zng_functable_entry(i) != NULL; i++)
+            zng_functable_select(zng_functable_entry(i), NULL);
+        zng_set_cpu_features(NULL);
+        free(compr);
+        free(uncompr);
+        free(data);
+    }
+
+    /* Compresses data into out, which holds compr_size bytes, and returns the compressed length */
+    size_t compress(int32_t level, int32_t window_bits, uint8_t *out) {
+        size_t compr_len = compress_buffer(data, DATA_SIZE, out, compr_size, level, window_bits);
+
+        EXPECT_GT(compr_len, 0u);
+        return compr_len;
+    }
+
+    /* Compresses data with a gzip or zlib wrapper and decompresses it again */
+    void round_trip(int32_t level, int32_t window_bits) {
+        size_t compr_len = compress(level, window_bits, compr);
+
+        EXPECT_EQ(uncompress_buffer(compr, compr_len, uncompr, DATA_SIZE, window_bits), (size_t)DATA_SIZE);
+        EXPECT_EQ(memcmp(uncompr, data, DATA_SIZE), 0);
+    }
+};
+
+TEST_F(functable, variants) {
+    uint32_t adler = zng_adler32(1, data, DATA_SIZE);
+    uint32_t crc = zng_crc32(0, data, DATA_SIZE);
+    int32_t i, j;
+
+    for (i = 0; zng_functable_entry(i) != NULL; i++) {
+        const char *entry = zng_functable_entry(i);
+        const char *variant;
+
+        for (j = 0; (variant = zng_functable_variant(entry, j)) != NULL; j++) {
+            SCOPED_TRACE(testing::Message() << entry << " " << variant);
+            ASSERT_EQ(zng_functable_select(entry, variant), Z_OK);
+
+            EXPECT_EQ(zng_adler32(1, data, DATA_SIZE), adler);
+            EXPECT_EQ(zng_crc32(0, data, DATA_SIZE), crc);
+            round_trip(1, MAX_WBITS);
+            round_trip(6, MAX_WBITS + 16);
+            round_trip(9, MAX_WBITS);
+        }
+        /* The generic variant is always available */
+        EXPECT_GT(j, 0);
+        EXPECT_EQ(zng_functable_select(entry, NULL), Z_OK);
+    }
+    EXPECT_GE(i, 10);
+}
+
+TEST_F(functable, select) {
+    EXPECT_EQ(zng_functable_entry(-1), (const char *)NULL);
+    EXPECT_STREQ(zng_functable_entry(0), "adler32");
+    EXPECT_STREQ(zng_functable_variant("inflate_fast", 1000), (const char *)NULL);
+    EXPECT_STREQ(zng_functable_variant("inflate_fast", -1), (const char *)NULL);
+    EXPECT_STREQ(zng_functable_variant("unknown", 0), (const char *)NULL);
+    EXPECT_STREQ(zng_functable_variant(NULL, 0), (const char *)NULL);
+
+    EXPECT_EQ(zng_functable_select("unknown", "c"), Z_STREAM_ERROR);
+    EXPECT_EQ(zng_functable_select(NULL, NULL), Z_STREAM_ERROR);
+    EXPECT_EQ(zng_functable_select("adler32", "unknown"), Z_STREAM_ERROR);
+    EXPECT_EQ(zng_functable_select("adler32", "c"), Z_OK);
+    EXPECT_EQ(zng_functable_select("adler32", NULL), Z_OK);
+}
+
+TEST_F(functable, dependent) {
+    const char *best = zng_functable_variant("deflate", 0);
+
+    ASSERT_TRUE(best != NULL);
+    if (strcmp(best, "c") == 0)
+        GTEST_SKIP() << "no deflate variants";
+
+    /* Variants with the kernels built in are unavailable while the functable uses other kernels */
+    EXPECT_EQ(zng_functable_select("deflate", best), Z_OK);
+    EXPECT_EQ(zng_functable_select("longest_match", "c"), Z_OK);
+    EXPECT_STREQ(zng_functable_variant("deflate", 0), "c");
+    EXPECT_EQ(zng_functable_select("deflate", best), Z_STREAM_ERROR);
+    round_trip(6, MAX_WBITS);
+    EXPECT_EQ(zng_functable_select("longest_match", NULL), Z_OK);
+    EXPECT_STREQ(zng_functable_variant("deflate", 0), best);
+    round_trip(9, MAX_WBITS);
+}
+
+TEST_F(functable, deflate_output) {
+    uint8_t *expected = (uint8_t *)malloc(compr_size);
+    const char *variant;
+
+    /* Every deflate variant, including the instances built for windowBits 15 and one level, produces the same stream */
+    ASSERT_TRUE(expected != NULL);
+    for (int32_t window_bits = MAX_WBITS - 1; window_bits <= MAX_WBITS; window_bits++) {
+        for (int32_t level = 1; level <= 9; level++) {
+            ASSERT_EQ(zng_functable_select("deflate", "c"), Z_OK);
+            size_t expected_len = compress(level, window_bits, expected);
+
+            for (int32_t i = 0; (variant = zng_functable_variant("deflate", i)) != NULL; i++) {
+                SCOPED_TRACE(testing::Message() << variant << " level " << level << " window_bits " << window_bits);
+                ASSERT_EQ(zng_functable_select("deflate", variant), Z_OK);
+                ASSERT_EQ(compress(level, window_bits, compr), expected_len);
+                EXPECT_EQ(memcmp(compr, expected, expected_len), 0);
+            }
+        }
+    }
+    free(expected);
+}
+
+TEST_F(functable, cpu_features) {
+    int32_t i;
+
+    EXPECT_EQ(zng_set_cpu_features("unknown"), Z_STREAM_ERROR);
+    EXPECT_EQ(zng_set_cpu_features("all,-unknown"), Z_STREAM_ERROR);
+
+    /* Without features, only the generic variants are left */
+    EXPECT_EQ(zng_set_cpu_features("none"), Z_OK);
+    for (i = 0; zng_functable_entry(i) != NULL; i++) {
+        const char *entry = zng_functable_entry(i);
+        const char *variant = zng_functable_variant(entry, 0);
+
+        ASSERT_TRUE(variant != NULL);
+        EXPECT_TRUE(strcmp(variant, "c") == 0 || strcmp(variant, "braid") == 0 || strncmp(variant, "unaligned_", 10) == 0)
+            << entry << " " << variant;
+    }
+    round_trip(6, MAX_WBITS + 16);
+
+    /* A selected variant that is masked falls back to the preferred one */
+    EXPECT_EQ(zng_set_cpu_features(NULL), Z_OK);
+    const char *best = zng_functable_variant("slide_hash", 0);
+    if (strcmp(best, "c") == 0)
+        GTEST_SKIP() << "no optimized slide_hash";
+    std::string feature = best;
+    std::string spec = "all,-" + feature;
+    EXPECT_EQ(zng_functable_select("slide_hash", best), Z_OK);
+    if (zng_set_cpu_features(spec.c_str()) == Z_OK) {
+        for (i = 0; zng_functable_variant("slide_hash", i) != NULL; i++)
+            EXPECT_STRNE(zng_functable_variant("slide_hash", i), best);
+        EXPECT_EQ(zng_functable_select("slide_hash", best), Z_STREAM_ERROR);
+        round_trip(9, MAX_WBITS);
+    }
+    EXPECT_EQ(zng_set_cpu_features(NULL), Z_OK);
+    EXPECT_STREQ(zng_functable_variant("slide_hash", 0), best);
+}
@@ -0,0 +1,56 @@
+/* test_functable_ifunc.cc - Test that WITH_IFUNC binds the checksums the functable prefers */
+
+#include <string.h>
+
+extern "C" {
+#  include "zbuild.h"
+#  include "cpu_features.h"
+}
+#include "zlib-ng.h"
+
+#include <gtest/gtest.h>
+
+/* Finds the function of the variant named want */
+#define FIND_VARIANT(name, cpu_has, f) \
+    if (strcmp(name, want) == 0) \
+        func = &f;
+
+static adler32_func adler32_find(const char *want) {
+    adler32_func func = NULL;
+    ADLER32_VARIANTS(FIND_VARIANT)
+    return func;
+}
+
+static crc32_func crc32_find(const char *want) {
+    crc32_func func = NULL;
+    CRC32_VARIANTS(FIND_VARIANT)
+    return func;
+}
+
+class functable_ifunc : public testing::Test {
+public:
+    void SetUp() override {
+        /* The resolvers don't see ZLIBNG_CPU, so the functable has to choose from all the detected features too */
+        ASSERT_EQ(zng_set_cpu_features("all"), Z_OK);
+    }
+
+    void TearDown() override {
+        zng_set_cpu_features(NULL);
+    }
+};
+
+TEST_F(functable_ifunc, adler32) {
+    const char *preferred = zng_functable_variant("adler32", 0);
+
+    ASSERT_TRUE(preferred != NULL);
+    EXPECT_TRUE(adler32_resolve() == adler32_find(preferred)) << "functable prefers " << preferred;
+    EXPECT_EQ(zng_adler32(1, (const uint8_t *)"abacus", 6), 0x08400270u);
+}
+
+TEST_F(functable_ifunc, crc32) {
+    const char *preferred = zng_functable_variant("crc32", 0);
+
+    ASSERT_TRUE(preferred != NULL);
+    EXPECT_TRUE(crc32_resolve() == crc32_find(preferred)) << "functable prefers " << preferred;
+    EXPECT_EQ(zng_crc32(0, (const uint8_t *)"abacus", 6), 0xc3d7115bu);
+}
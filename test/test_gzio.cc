@@ -103,3 +103,64 @@ TEST(gzip, readwrite) {
     Z_UNUSED(read);
 #endif
 }
+
+/* Read the same files with and without mapping them into memory */
+TEST(gzip, mmap) {
+#ifdef NO_GZCOMPRESS
+    GTEST_SKIP();
+#else
+    static const char *modes[] = { "rb", "rbm" };
+    const size_t data_len = 1024 * 1024;
+    uint8_t *data = (uint8_t *)malloc(data_len), *out = (uint8_t *)malloc(2 * data_len + 1);
+    uint32_t seed = 1;
+    gzFile file;
+    FILE *f;
+
+    ASSERT_TRUE(data != NULL && out != NULL);
+    for (size_t i = 0; i < data_len; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + (seed >> 16) % 5);
+    }
+
+    /* Two gzip members */
+    for (int member = 0; member < 2; member++) {
+        file = PREFIX(gzopen)(TESTFILE, member ? "ab" : "wb");
+        ASSERT_TRUE(file != NULL);
+        EXPECT_EQ(PREFIX(gzwrite)(file, data, (unsigned)data_len), (int)data_len);
+        EXPECT_EQ(PREFIX(gzclose)(file), Z_OK);
+    }
+    for (int m = 0; m < 2; m++) {
+        file = PREFIX(gzopen)(TESTFILE, modes[m]);
+        ASSERT_TRUE(file != NULL);
+        EXPECT_EQ(PREFIX(gzread)(file, out, (unsigned)(2 * data_len + 1)), (int)(2 * data_len)) << modes[m];
+        EXPECT_EQ(memcmp(out, data, data_len), 0) << modes[m];
+        EXPECT_EQ(memcmp(out + data_len, data, data_len), 0) << modes[m];
+        EXPECT_EQ(PREFIX(gzeof)(file), 1) << modes[m];
+        EXPECT_EQ(PREFIX(gzseek)(file, 12345, SEEK_SET), 12345) << modes[m];
+        EXPECT_EQ(PREFIX(gzread)(file, out, 1000), 1000) << modes[m];
+        EXPECT_EQ(memcmp(out, data + 12345, 1000), 0) << modes[m];
+        EXPECT_EQ(PREFIX(gzclose)(file), Z_OK);
+    }
+
+    /* Not gzip, copied directly */
+    f = fopen(TESTFILE, "wb");
+    ASSERT_TRUE(f != NULL);
+    EXPECT_EQ(fwrite(data, 1, data_len, f), data_len);
+    fclose(f);
+    for (int m = 0; m < 2; m++) {
+        file = PREFIX(gzopen)(TESTFILE, modes[m]);
+        ASSERT_TRUE(file != NULL);
+        EXPECT_EQ(PREFIX(gzgetc)(file), data[0]) << modes[m];
+        EXPECT_EQ(PREFIX(gzdirect)(file), 1) << modes[m];
+        EXPECT_EQ(PREFIX(gzseek)(file, 500000, SEEK_SET), 500000) << modes[m];
+        EXPECT_EQ(PREFIX(gzread)(file, out, (unsigned)data_len), (int)(data_len - 500000)) << modes[m];
+        EXPECT_EQ(memcmp(out, data + 500000, data_len - 500000), 0) << modes[m];
+        EXPECT_EQ(PREFIX(gzoffset)(file), (z_off64_t)data_len) << modes[m];
+        EXPECT_EQ(PREFIX(gzclose)(file), Z_OK);
+    }
+
+    remove(TESTFILE);
+    free(out);
+    free(data);
+#endif
+}
@@ -0,0 +1,445 @@
+/* test_gzio_bgzf.cc - Test writing BGZF files with gzopen() mode "B" */
+
+#include "zbuild.h"
+#include "zlib-ng.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#define TESTFILE "bgzf.gz"
+#define INDEXFILE "bgzf.gz.gzi"
+#define DATA_SIZE (1024 * 1024)
+#define RANDOM_SIZE (200 * 1024)
+#define BLOCK_DATA 65280
+#define BLOCK_MAX 65536
+
+static const uint8_t bgzf_eof[28] = {
+    31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 66, 67, 2, 0, 27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+class gzio_bgzf : public testing::Test {
+public:
+    uint8_t *data = NULL;
+    uint8_t *expect = NULL;
+    size_t expect_len = 0;
+    /* compressed and uncompressed offsets of the blocks found by check() */
+    std::vector<uint64_t> starts;
+
+    void SetUp() override {
+        static const char *words[] = { "block ", "bgzf ", "member ", "extra ", "index ", "\n" };
+        uint32_t seed = 11;
+        size_t i = 0;
+
+        data = (uint8_t *)malloc(DATA_SIZE);
+        expect = (uint8_t *)malloc(2 * DATA_SIZE);
+        ASSERT_TRUE(data != NULL && expect != NULL);
+        while (i < DATA_SIZE) {
+            seed = seed * 1103515245 + 12345;
+            if (i >= DATA_SIZE / 2 && i < DATA_SIZE / 2 + RANDOM_SIZE) {
+                /* incompressible, so that blocks have to be stored */
+                data[i++] = (uint8_t)(seed >> 16);
+                continue;
+            }
+            const char *word = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+            size_t len = MIN(strlen(word), DATA_SIZE - i);
+            memcpy(data + i, word, len);
+            i += len;
+        }
+    }
+
+    void TearDown() override {
+        remove(TESTFILE);
+        remove(INDEXFILE);
+        free(expect);
+        free(data);
+    }
+
+    gzFile open(int32_t threads) {
+        gzFile file = zng_gzopen(TESTFILE, "wbB");
+        EXPECT_TRUE(file != NULL);
+#ifdef WITH_THREADS
+        EXPECT_EQ(zng_gzsetthreads(file, threads), 0);
+#else
+        EXPECT_EQ(zng_gzsetthreads(file, threads), threads ? -1 : 0);
+#endif
+        expect_len = 0;
+        return file;
+    }
+
+    /* Write the test data in writes of varying size, with flushes and parameter changes */
+    void write(gzFile file) {
+        size_t pos = 0, len;
+        uint32_t seed = 5;
+        int n = 0;
+
+        while (pos < DATA_SIZE) {
+            seed = seed * 1103515245 + 12345;
+            len = MIN((size_t)((seed >> 16) % (n % 8 == 0 ? 3 * BLOCK_DATA : 5000)), DATA_SIZE - pos);
+            EXPECT_EQ(zng_gzwrite(file, data + pos, (uint32_t)len), (int32_t)len);
+            memcpy(expect + expect_len, data + pos, len);
+            expect_len += len;
+            pos += len;
+            switch (n++ % 16) {
+            case 3:
+                EXPECT_EQ(zng_gzputc(file, 'x'), 'x');
+                expect[expect_len++] = 'x';
+                break;
+            case 7:
+                len = (size_t)sprintf((char *)expect + expect_len, "%d;", n);
+                EXPECT_EQ(zng_gzprintf(file, "%d;", n), (int)len);
+                expect_len += len;
+                break;
+            case 11:
+                EXPECT_EQ(zng_gzsetparams(file, n % 32 < 16 ? 1 : 9, Z_DEFAULT_STRATEGY), Z_OK);
+                break;
+            case 13:
+                EXPECT_EQ(zng_gzflush(file, n % 32 < 16 ? Z_SYNC_FLUSH : Z_FINISH), Z_OK);
+                break;
+            }
+        }
+    }
+
+    void load(uint8_t **compr, size_t *compr_len) {
+        FILE *f = fopen(TESTFILE, "rb");
+        ASSERT_TRUE(f != NULL);
+        fseek(f, 0, SEEK_END);
+        *compr_len = (size_t)ftell(f);
+        fseek(f, 0, SEEK_SET);
+        *compr = (uint8_t *)malloc(*compr_len + 1);
+        ASSERT_TRUE(*compr != NULL);
+        EXPECT_EQ(fread(*compr, 1, *compr_len, f), *compr_len);
+        fclose(f);
+    }
+
+    /* Check that the file is a sequence of BGZF blocks ending with the end of file marker, each decompressing on its
+       own, and together giving the expected data */
+    void check(void) {
+        uint8_t *compr = NULL, *out;
+        size_t compr_len = 0, pos = 0, out_len = 0;
+        zng_stream strm;
+
+        load(&compr, &compr_len);
+        out = (uint8_t *)malloc(expect_len + BLOCK_DATA);
+        ASSERT_TRUE(compr != NULL && out != NULL);
+        memset(&strm, 0, sizeof(strm));
+        ASSERT_EQ(zng_inflateInit2(&strm, -MAX_WBITS), Z_OK);
+        starts.clear();
+
+        while (pos + 28 < compr_len) {
+            uint8_t *block = compr + pos;
+            ASSERT_EQ(memcmp(block, bgzf_eof, 16), 0) << "block at " << pos;
+            size_t size = block[16] + ((size_t)block[17] << 8) + 1;
+            ASSERT_LE(pos + size, compr_len);
+            uint32_t crc = block[size - 8] | (block[size - 7] << 8) | (block[size - 6] << 16) |
+                           ((uint32_t)block[size - 5] << 24);
+            uint32_t len = block[size - 4] | (block[size - 3] << 8) | (block[size - 2] << 16) |
+                           ((uint32_t)block[size - 1] << 24);
+            EXPECT_GT(len, 0u);
+            ASSERT_LE(len, (uint32_t)BLOCK_DATA);
+            ASSERT_LE(out_len + len, expect_len);
+
+            ASSERT_EQ(zng_inflateReset(&strm), Z_OK);
+            strm.next_in = block + 18;
+            strm.avail_in = (uint32_t)size - 26;
+            strm.next_out = out + out_len;
+            strm.avail_out = BLOCK_DATA;
+            EXPECT_EQ(zng_inflate(&strm, Z_FINISH), Z_STREAM_END) << "block at " << pos;
+            EXPECT_EQ(strm.avail_in, 0u);
+            EXPECT_EQ(strm.total_out, len);
+            EXPECT_EQ(zng_crc32(0, out + out_len, len), crc);
+
+            starts.push_back(pos);
+            starts.push_back(out_len);
+            pos += size;
+            out_len += len;
+        }
+        EXPECT_EQ(pos + 28, compr_len);
+        EXPECT_EQ(memcmp(compr + pos, bgzf_eof, 28), 0);
+        EXPECT_EQ(out_len, expect_len);
+        EXPECT_EQ(memcmp(out, expect, expect_len), 0);
+        EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+        free(out);
+        free(compr);
+    }
+
+    /* Check that gzread() decompresses the file */
+    void check_read(void) {
+        uint8_t *out = (uint8_t *)malloc(expect_len + 1);
+        gzFile file;
+
+        ASSERT_TRUE(out != NULL);
+        file = zng_gzopen(TESTFILE, "rb");
+        ASSERT_TRUE(file != NULL);
+        EXPECT_EQ(zng_gzread(file, out, (uint32_t)expect_len + 1), (int32_t)expect_len);
+        EXPECT_EQ(memcmp(out, expect, expect_len), 0);
+        EXPECT_EQ(zng_gzclose(file), Z_OK);
+        free(out);
+    }
+
+    void save(const uint8_t *compr, size_t compr_len) {
+        FILE *f = fopen(TESTFILE, "wb");
+        ASSERT_TRUE(f != NULL);
+        EXPECT_EQ(fwrite(compr, 1, compr_len, f), compr_len);
+        fclose(f);
+    }
+
+    /* Read up to size bytes of the file into out, decompressing BGZF members on threads threads, in reads of
+       varying size through gzread(), gzgetc() with gzungetc(), and gzgets(). Return the number of bytes read and
+       the error at the end in err. */
+    size_t read(int32_t threads, uint8_t *out, size_t size, int *err) {
+        gzFile file = zng_gzopen(TESTFILE, "rb");
+        size_t pos = 0, len;
+        uint32_t seed = 7;
+        char line[300];
+        int n = 0, c;
+
+        EXPECT_TRUE(file != NULL);
+#ifdef WITH_THREADS
+        EXPECT_EQ(zng_gzsetthreads(file, threads), 0);
+#else
+        Z_UNUSED(threads);
+#endif
+        while (pos < size) {
+            seed = seed * 1103515245 + 12345;
+            if (n % 8 == 3) {
+                c = zng_gzgetc(file);
+                if (c == -1)
+                    break;
+                EXPECT_EQ(zng_gzungetc(c, file), c);
+                EXPECT_EQ(zng_gzungetc('?', file), '?');
+                EXPECT_EQ(zng_gzgetc(file), '?');
+                len = 1;
+                EXPECT_EQ(zng_gzread(file, out + pos, 1), 1);
+            } else if (n % 8 == 6) {
+                z_off64_t start = zng_gztell(file);
+                if (zng_gzgets(file, line, (int)MIN(sizeof(line), size - pos + 1)) == NULL)
+                    break;
+                len = (size_t)(zng_gztell(file) - start);
+                memcpy(out + pos, line, len);
+            } else {
+                len = MIN((seed >> 16) % (n % 4 == 0 ? 3 * BLOCK_DATA : 3000) + 1, size - pos);
+                int32_t got = zng_gzread(file, out + pos, (uint32_t)len);
+                if (got <= 0)
+                    break;
+                len = (size_t)got;
+            }
+            pos += len;
+            n++;
+        }
+        zng_gzerror(file, err);
+        EXPECT_NE(zng_gzclose(file), Z_STREAM_ERROR);
+        return pos;
+    }
+};
+
+TEST_F(gzio_bgzf, blocks) {
+    gzFile file = open(0);
+    write(file);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    check();
+    check_read();
+    /* short blocks are only written when flushing */
+    EXPECT_LT(starts.size() / 2, expect_len / BLOCK_DATA + 40);
+}
+
+TEST_F(gzio_bgzf, threads) {
+    uint8_t *single = NULL, *compr = NULL;
+    size_t single_len = 0, compr_len = 0;
+
+    gzFile file = open(0);
+    write(file);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    load(&single, &single_len);
+
+    /* the blocks are compressed independently, so the threads give the same file */
+    file = open(3);
+    write(file);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    load(&compr, &compr_len);
+    EXPECT_EQ(compr_len, single_len);
+    EXPECT_EQ(memcmp(compr, single, MIN(compr_len, single_len)), 0);
+    check();
+    free(compr);
+    free(single);
+}
+
+TEST_F(gzio_bgzf, index) {
+    uint8_t buf[8];
+    uint64_t val[2];
+    FILE *f;
+
+    for (int32_t threads = 0; threads < 3; threads += 2) {
+        gzFile file = open(threads);
+        EXPECT_EQ(zng_gzbgzfindex(file, INDEXFILE), 0);
+        write(file);
+        EXPECT_EQ(zng_gzclose(file), Z_OK);
+        check();
+
+        /* the index lists every block but the first */
+        f = fopen(INDEXFILE, "rb");
+        ASSERT_TRUE(f != NULL);
+        ASSERT_EQ(fread(buf, 1, 8, f), 8u);
+        val[0] = 0;
+        for (int k = 7; k >= 0; k--)
+            val[0] = (val[0] << 8) | buf[k];
+        EXPECT_EQ(val[0], starts.size() / 2 - 1);
+        for (size_t i = 2; i < starts.size(); i += 2) {
+            for (int j = 0; j < 2; j++) {
+                ASSERT_EQ(fread(buf, 1, 8, f), 8u);
+                val[j] = 0;
+                for (int k = 7; k >= 0; k--)
+                    val[j] = (val[j] << 8) | buf[k];
+            }
+            EXPECT_EQ(val[0], starts[i]) << "threads " << threads;
+            EXPECT_EQ(val[1], starts[i + 1]) << "threads " << threads;
+        }
+        EXPECT_EQ(fread(buf, 1, 1, f), 0u);
+        fclose(f);
+    }
+}
+
+TEST_F(gzio_bgzf, empty) {
+    uint8_t *compr = NULL;
+    size_t compr_len = 0;
+
+    gzFile file = open(0);
+    EXPECT_EQ(zng_gzflush(file, Z_FINISH), Z_OK);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    load(&compr, &compr_len);
+    ASSERT_EQ(compr_len, sizeof(bgzf_eof));
+    EXPECT_EQ(memcmp(compr, bgzf_eof, sizeof(bgzf_eof)), 0);
+    free(compr);
+    check_read();
+}
+
+TEST_F(gzio_bgzf, errors) {
+    gzFile file = zng_gzopen(TESTFILE, "wb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzbgzfindex(file, INDEXFILE), -1);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    file = open(0);
+    EXPECT_EQ(zng_gzbgzfindex(file, NULL), -1);
+    EXPECT_EQ(zng_gzwrite(file, data, 100), 100);
+    EXPECT_EQ(zng_gzbgzfindex(file, INDEXFILE), -1);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    file = zng_gzopen(TESTFILE, "rbB");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzbgzfindex(file, INDEXFILE), -1);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+}
+
+TEST_F(gzio_bgzf, read_threads) {
+    uint8_t *out = (uint8_t *)malloc(2 * DATA_SIZE);
+    int err;
+
+    ASSERT_TRUE(out != NULL);
+    gzFile file = open(0);
+    write(file);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    for (int32_t threads = 0; threads <= 4; threads += 2) {
+        memset(out, 0, 2 * DATA_SIZE);
+        EXPECT_EQ(read(threads, out, 2 * DATA_SIZE, &err), expect_len) << "threads " << threads;
+        EXPECT_EQ(err, Z_OK);
+        EXPECT_EQ(memcmp(out, expect, expect_len), 0) << "threads " << threads;
+    }
+    free(out);
+}
+
+TEST_F(gzio_bgzf, read_mixed) {
+    uint8_t *out = (uint8_t *)malloc(2 * DATA_SIZE);
+    size_t len = 100000;
+    int err;
+
+    ASSERT_TRUE(out != NULL);
+    gzFile file = open(0);
+    write(file);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    /* BGZF members followed by an ordinary gzip member, then more BGZF members */
+    file = zng_gzopen(TESTFILE, "ab");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzwrite(file, data, (uint32_t)len), (int32_t)len);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    memcpy(expect + expect_len, data, len);
+    expect_len += len;
+    file = zng_gzopen(TESTFILE, "abB");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzwrite(file, data + len, (uint32_t)(3 * len)), (int32_t)(3 * len));
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    memcpy(expect + expect_len, data + len, 3 * len);
+    expect_len += 3 * len;
+
+    EXPECT_EQ(read(3, out, 2 * DATA_SIZE, &err), expect_len);
+    EXPECT_EQ(err, Z_OK);
+    EXPECT_EQ(memcmp(out, expect, expect_len), 0);
+    free(out);
+}
+
+TEST_F(gzio_bgzf, read_errors) {
+    uint8_t *out = (uint8_t *)malloc(2 * DATA_SIZE), *compr = NULL;
+    size_t compr_len = 0, got;
+    int err;
+
+    ASSERT_TRUE(out != NULL);
+    gzFile file = open(0);
+    write(file);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    check();
+    ASSERT_GT(starts.size(), 12u);
+    load(&compr, &compr_len);
+
+    /* a corrupted member is reported, the data before it is delivered */
+    size_t mid = (size_t)(starts[10] + starts[12]) / 2;
+    compr[mid] ^= 0x55;
+    save(compr, compr_len);
+    for (int32_t threads = 0; threads <= 3; threads += 3) {
+        got = read(threads, out, 2 * DATA_SIZE, &err);
+        EXPECT_EQ(err, Z_DATA_ERROR) << "threads " << threads;
+        EXPECT_GE(got, starts[9]) << "threads " << threads;
+        EXPECT_LT(got, starts[13]) << "threads " << threads;
+        EXPECT_EQ(memcmp(out, expect, MIN(got, starts[11])), 0) << "threads " << threads;
+    }
+
+    /* so is a file cut short in a member, after delivering what could be decompressed */
+    compr[mid] ^= 0x55;
+    save(compr, mid);
+    for (int32_t threads = 0; threads <= 3; threads += 3) {
+        got = read(threads, out, 2 * DATA_SIZE, &err);
+        EXPECT_EQ(err, Z_BUF_ERROR) << "threads " << threads;
+        EXPECT_GE(got, starts[11]) << "threads " << threads;
+        EXPECT_LT(got, starts[13]) << "threads " << threads;
+        EXPECT_EQ(memcmp(out, expect, got), 0) << "threads " << threads;
+    }
+    free(compr);
+    free(out);
+}
+
+TEST_F(gzio_bgzf, read_seek) {
+    uint8_t buf[5000];
+
+    gzFile file = open(0);
+    write(file);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    file = zng_gzopen(TESTFILE, "rb");
+    ASSERT_TRUE(file != NULL);
+#ifdef WITH_THREADS
+    EXPECT_EQ(zng_gzsetthreads(file, 2), 0);
+#endif
+    /* forward seeks skip output, backward ones start over from the beginning */
+    z_off64_t offsets[] = { 500000, 1000, 300000, 0, 700000, 699000 };
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        EXPECT_EQ(zng_gzseek(file, offsets[i], SEEK_SET), offsets[i]);
+        EXPECT_EQ(zng_gzread(file, buf, sizeof(buf)), (int32_t)sizeof(buf));
+        EXPECT_EQ(memcmp(buf, expect + offsets[i], sizeof(buf)), 0) << "offset " << offsets[i];
+    }
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+}
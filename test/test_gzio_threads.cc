@@ -0,0 +1,472 @@
+/* test_gzio_threads.cc - Test .gz files with background compression, decompression and readahead threads */
+
+#include "zbuild.h"
+#include "zlib-ng.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#  include <unistd.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#define TESTFILE "threads.gz"
+#define INDEXFILE "threads.gzidx"
+#define INDEX_SPAN (100 * 1024)
+#define DATA_SIZE (3 * 1024 * 1024)
+#define CHUNK_SIZE (64 * 1024)
+
+class gzio_threads : public testing::Test {
+public:
+    uint8_t *data = NULL;
+    uint8_t *expect = NULL;
+    size_t expect_len = 0;
+
+    void SetUp() override {
+        static const char *words[] = { "gzwrite ", "thread ", "chunk ", "dictionary ", "member ", "\n" };
+        uint32_t seed = 3;
+        size_t i = 0;
+
+        data = (uint8_t *)malloc(DATA_SIZE);
+        expect = (uint8_t *)malloc(2 * DATA_SIZE);
+        ASSERT_TRUE(data != NULL && expect != NULL);
+        while (i < DATA_SIZE) {
+            seed = seed * 1103515245 + 12345;
+            const char *word = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+            size_t len = MIN(strlen(word), DATA_SIZE - i);
+            memcpy(data + i, word, len);
+            i += len;
+            if (((seed >> 8) & 31) == 0 && i < DATA_SIZE)
+                data[i++] = (uint8_t)(seed >> 24);
+        }
+    }
+
+    void TearDown() override {
+        remove(TESTFILE);
+        remove(INDEXFILE);
+        free(expect);
+        free(data);
+    }
+
+    gzFile open(int32_t threads) {
+        gzFile file = zng_gzopen(TESTFILE, "wb");
+        EXPECT_TRUE(file != NULL);
+        EXPECT_EQ(zng_gzbuffer(file, CHUNK_SIZE), 0);
+#ifdef WITH_THREADS
+        EXPECT_EQ(zng_gzsetthreads(file, threads), 0);
+#else
+        EXPECT_EQ(zng_gzsetthreads(file, threads), threads ? -1 : 0);
+#endif
+        expect_len = 0;
+        return file;
+    }
+
+    void put(gzFile file, const uint8_t *buf, size_t len) {
+        EXPECT_EQ(zng_gzwrite(file, buf, (uint32_t)len), (int32_t)len);
+        memcpy(expect + expect_len, buf, len);
+        expect_len += len;
+    }
+
+    /* Write the test data in writes of varying size through all the write functions */
+    void write(gzFile file) {
+        size_t pos = 0, len;
+        uint32_t seed = 5;
+        int n = 0;
+
+        while (pos < DATA_SIZE) {
+            seed = seed * 1103515245 + 12345;
+            len = MIN((size_t)((seed >> 16) % (n % 8 == 0 ? 3 * CHUNK_SIZE : 5000)), DATA_SIZE - pos);
+            put(file, data + pos, len);
+            pos += len;
+            switch (n++ % 16) {
+            case 3:
+                EXPECT_EQ(zng_gzputc(file, 'x'), 'x');
+                expect[expect_len++] = 'x';
+                break;
+            case 7:
+                len = (size_t)sprintf((char *)expect + expect_len, "%d;", n);
+                EXPECT_EQ(zng_gzprintf(file, "%d;", n), (int)len);
+                expect_len += len;
+                break;
+            case 9:
+                EXPECT_EQ(zng_gzseek(file, 1000, SEEK_CUR), (z_off64_t)expect_len + 1000);
+                memset(expect + expect_len, 0, 1000);
+                expect_len += 1000;
+                break;
+            case 11:
+                EXPECT_EQ(zng_gzsetparams(file, n % 32 < 16 ? 1 : 9, Z_DEFAULT_STRATEGY), Z_OK);
+                break;
+            case 13:
+                EXPECT_EQ(zng_gzflush(file, n % 32 < 16 ? Z_SYNC_FLUSH : Z_FULL_FLUSH), Z_OK);
+                break;
+            }
+        }
+    }
+
+    void load(uint8_t **compr, size_t *compr_len) {
+        FILE *f = fopen(TESTFILE, "rb");
+        ASSERT_TRUE(f != NULL);
+        fseek(f, 0, SEEK_END);
+        *compr_len = (size_t)ftell(f);
+        fseek(f, 0, SEEK_SET);
+        *compr = (uint8_t *)malloc(*compr_len);
+        ASSERT_TRUE(*compr != NULL);
+        EXPECT_EQ(fread(*compr, 1, *compr_len, f), *compr_len);
+        fclose(f);
+    }
+
+    /* Check that the file is a single gzip member with the expected contents */
+    void check_member(void) {
+        uint8_t *compr = NULL, *out;
+        size_t compr_len = 0;
+        zng_stream strm;
+
+        load(&compr, &compr_len);
+        out = (uint8_t *)malloc(expect_len + 1);
+        ASSERT_TRUE(out != NULL);
+        memset(&strm, 0, sizeof(strm));
+        ASSERT_EQ(zng_inflateInit2(&strm, MAX_WBITS + 16), Z_OK);
+        strm.next_in = compr;
+        strm.avail_in = (uint32_t)compr_len;
+        strm.next_out = out;
+        strm.avail_out = (uint32_t)expect_len + 1;
+        EXPECT_EQ(zng_inflate(&strm, Z_FINISH), Z_STREAM_END);
+        EXPECT_EQ(strm.avail_in, 0u);
+        EXPECT_EQ(strm.total_out, expect_len);
+        EXPECT_EQ(memcmp(out, expect, expect_len), 0);
+        EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+        free(out);
+        free(compr);
+    }
+
+    /* Check the contents of the file with gzread() */
+    void check_read(void) {
+        uint8_t *out = (uint8_t *)malloc(expect_len + 1);
+        gzFile file;
+
+        ASSERT_TRUE(out != NULL);
+        file = zng_gzopen(TESTFILE, "rb");
+        ASSERT_TRUE(file != NULL);
+        EXPECT_EQ(zng_gzread(file, out, (uint32_t)expect_len + 1), (int32_t)expect_len);
+        EXPECT_EQ(memcmp(out, expect, expect_len), 0);
+        EXPECT_EQ(zng_gzclose(file), Z_OK);
+        free(out);
+    }
+
+    /* Read file up to its end in reads of varying size, return the number of bytes read */
+    size_t read_all(gzFile file, uint8_t *out, size_t size, uint32_t seed) {
+        size_t pos = 0, len;
+        int32_t got;
+
+        do {
+            seed = seed * 1103515245 + 12345;
+            len = MIN((size_t)((seed >> 16) % 100000) + 1, size - pos);
+            got = zng_gzread(file, out + pos, (uint32_t)len);
+            if (got > 0)
+                pos += (size_t)got;
+        } while (got > 0 && pos < size);
+        return pos;
+    }
+
+    /* Read the file with the index built and saved by a serial read, which must give the same output */
+    void check_index(const char *mode, int32_t threads, int32_t readahead) {
+        uint8_t *serial = (uint8_t *)malloc(expect_len + 1), *out = (uint8_t *)malloc(expect_len + 1);
+        z_off64_t offset;
+        gzFile file;
+
+        ASSERT_TRUE(serial != NULL && out != NULL);
+        file = zng_gzopen(TESTFILE, "rb");
+        ASSERT_TRUE(file != NULL);
+        EXPECT_EQ(zng_gzindex(file, INDEX_SPAN), 0);
+        EXPECT_EQ(read_all(file, serial, expect_len + 1, 1), expect_len);
+        EXPECT_EQ(memcmp(serial, expect, expect_len), 0);
+        EXPECT_EQ(zng_gzindexsave(file, INDEXFILE), 0);
+        EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+        file = zng_gzopen(TESTFILE, mode);
+        ASSERT_TRUE(file != NULL);
+        EXPECT_EQ(zng_gzbuffer(file, 16384), 0);
+#ifdef WITH_THREADS
+        EXPECT_EQ(zng_gzsetthreads(file, threads), 0);
+        EXPECT_EQ(zng_gzreadahead(file, readahead), 0);
+#else
+        (void)threads;
+        (void)readahead;
+#endif
+        EXPECT_EQ(zng_gzindexload(file, INDEXFILE), 0);
+        memset(out, 0, expect_len);
+        EXPECT_EQ(read_all(file, out, expect_len + 1, 2), expect_len);
+        EXPECT_EQ(memcmp(out, serial, expect_len), 0);
+        EXPECT_TRUE(zng_gzeof(file));
+
+        /* seeks resume at an access point, and continue with the spans after it */
+        for (offset = (z_off64_t)expect_len - 5000; offset > 0; offset -= 345678) {
+            EXPECT_EQ(zng_gzseek(file, offset, SEEK_SET), offset);
+            EXPECT_EQ(zng_gzread(file, out, 5000), 5000);
+            EXPECT_EQ(memcmp(out, serial + offset, 5000), 0) << "offset " << offset;
+        }
+        EXPECT_EQ(zng_gzseek(file, 1000, SEEK_SET), 1000);
+        EXPECT_EQ(read_all(file, out, expect_len + 1, 3), expect_len - 1000);
+        EXPECT_EQ(memcmp(out, serial + 1000, expect_len - 1000), 0);
+
+        /* after a rewind, the spans are used again, also with an index replaced in between */
+        EXPECT_EQ(zng_gzrewind(file), 0);
+        EXPECT_EQ(zng_gzread(file, out, 50000), 50000);
+        EXPECT_EQ(zng_gzindexload(file, INDEXFILE), 0);
+        EXPECT_EQ(read_all(file, out + 50000, expect_len + 1 - 50000, 4), expect_len - 50000);
+        EXPECT_EQ(memcmp(out, serial, expect_len), 0);
+        EXPECT_EQ(zng_gzclose(file), Z_OK);
+        free(out);
+        free(serial);
+    }
+};
+
+TEST_F(gzio_threads, single_member) {
+    for (int32_t threads = 1; threads <= 4; threads += 3) {
+        gzFile file = open(threads);
+        ASSERT_TRUE(file != NULL);
+        write(file);
+        EXPECT_EQ(zng_gzclose(file), Z_OK);
+        check_member();
+        check_read();
+    }
+}
+
+TEST_F(gzio_threads, empty) {
+    gzFile file = open(2);
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    check_member();
+}
+
+TEST_F(gzio_threads, finish) {
+    uint8_t *compr = NULL;
+    size_t compr_len = 0;
+    gzFile file;
+
+    /* Z_FINISH ends a gzip member, the next write starts another one */
+    file = open(3);
+    ASSERT_TRUE(file != NULL);
+    put(file, data, DATA_SIZE / 2);
+    EXPECT_EQ(zng_gzflush(file, Z_FINISH), Z_OK);
+    EXPECT_EQ(zng_gzflush(file, Z_FINISH), Z_OK);
+    put(file, data + DATA_SIZE / 2, DATA_SIZE / 2);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    check_read();
+
+    load(&compr, &compr_len);
+    EXPECT_GT(compr_len, 20u);
+    EXPECT_EQ(compr[0], 31);
+    EXPECT_EQ(compr[1], 139);
+    free(compr);
+}
+
+TEST_F(gzio_threads, errors) {
+    gzFile file;
+
+    EXPECT_EQ(zng_gzsetthreads(NULL, 1), -1);
+    file = zng_gzopen(TESTFILE, "wb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzsetthreads(file, -1), -1);
+    EXPECT_EQ(zng_gzsetthreads(file, 0), 0);
+    EXPECT_EQ(zng_gzwrite(file, data, 100), 100);
+    EXPECT_EQ(zng_gzsetthreads(file, 1), -1);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    file = zng_gzopen(TESTFILE, "rb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzgetc(file), data[0]);
+    EXPECT_EQ(zng_gzsetthreads(file, 1), -1);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+}
+
+TEST_F(gzio_threads, readahead) {
+    uint8_t *out = (uint8_t *)malloc(DATA_SIZE);
+    size_t pos = 0, len;
+    uint32_t seed = 9;
+    gzFile file;
+
+    ASSERT_TRUE(out != NULL);
+    file = open(0);
+    ASSERT_TRUE(file != NULL);
+    put(file, data, DATA_SIZE);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    file = zng_gzopen(TESTFILE, "rb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzbuffer(file, 4096), 0);
+#ifdef WITH_THREADS
+    EXPECT_EQ(zng_gzreadahead(file, 3), 0);
+#else
+    EXPECT_EQ(zng_gzreadahead(file, 3), -1);
+#endif
+    while (pos < DATA_SIZE) {
+        seed = seed * 1103515245 + 12345;
+        len = MIN((size_t)((seed >> 16) % 40000), DATA_SIZE - pos);
+        EXPECT_EQ(zng_gzread(file, out + pos, (uint32_t)len), (int32_t)len);
+        pos += len;
+    }
+    EXPECT_EQ(memcmp(out, data, DATA_SIZE), 0);
+    EXPECT_EQ(zng_gzread(file, out, 1), 0);
+    EXPECT_TRUE(zng_gzeof(file));
+
+    /* seeking back discards what was read ahead */
+    EXPECT_EQ(zng_gzseek(file, 123456, SEEK_SET), 123456);
+    EXPECT_EQ(zng_gzread(file, out, 5000), 5000);
+    EXPECT_EQ(memcmp(out, data + 123456, 5000), 0);
+    EXPECT_EQ(zng_gzrewind(file), 0);
+    EXPECT_EQ(zng_gzread(file, out, DATA_SIZE), DATA_SIZE);
+    EXPECT_EQ(memcmp(out, data, DATA_SIZE), 0);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    free(out);
+}
+
+TEST_F(gzio_threads, readahead_direct) {
+    uint8_t out[1000];
+    z_off64_t offset;
+    gzFile file;
+    FILE *f;
+
+    /* a file that is not gzip is copied, and seeks within it move the readahead position */
+    f = fopen(TESTFILE, "wb");
+    ASSERT_TRUE(f != NULL);
+    EXPECT_EQ(fwrite(data, 1, DATA_SIZE, f), (size_t)DATA_SIZE);
+    fclose(f);
+
+    file = zng_gzopen(TESTFILE, "rb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzbuffer(file, 8192), 0);
+#ifdef WITH_THREADS
+    EXPECT_EQ(zng_gzreadahead(file, 2), 0);
+#endif
+    EXPECT_EQ(zng_gzread(file, out, 100), 100);
+    EXPECT_TRUE(zng_gzdirect(file));
+    for (offset = DATA_SIZE - 1000; offset > 0; offset -= 654321) {
+        EXPECT_EQ(zng_gzseek(file, offset, SEEK_SET), offset);
+        EXPECT_EQ(zng_gzread(file, out, 1000), 1000);
+        EXPECT_EQ(memcmp(out, data + offset, 1000), 0) << "offset " << offset;
+    }
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+}
+
+TEST_F(gzio_threads, readahead_errors) {
+    gzFile file;
+
+    EXPECT_EQ(zng_gzreadahead(NULL, 1), -1);
+    file = open(0);
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzreadahead(file, 1), -1);
+    put(file, data, 1000);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    file = zng_gzopen(TESTFILE, "rb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzreadahead(file, -1), -1);
+    EXPECT_EQ(zng_gzreadahead(file, 0), 0);
+    EXPECT_EQ(zng_gzgetc(file), data[0]);
+    EXPECT_EQ(zng_gzreadahead(file, 1), -1);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+}
+
+#ifndef _WIN32
+TEST_F(gzio_threads, readahead_pipe) {
+    uint8_t out[64];
+    gzFile file;
+    int fds[2];
+
+    /* a pipe cannot be read ahead at explicit offsets, but is still read on the calling thread */
+    ASSERT_EQ(pipe(fds), 0);
+    ASSERT_EQ(::write(fds[1], data, sizeof(out)), (ssize_t)sizeof(out));
+    ::close(fds[1]);
+    file = zng_gzdopen(fds[0], "rb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzreadahead(file, 2), -1);
+    EXPECT_EQ(zng_gzreadahead(file, 0), 0);
+    EXPECT_EQ(zng_gzread(file, out, sizeof(out)), (int)sizeof(out));
+    EXPECT_EQ(memcmp(out, data, sizeof(out)), 0);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+}
+#endif
+
+TEST_F(gzio_threads, index_spans) {
+    gzFile file = open(0);
+    ASSERT_TRUE(file != NULL);
+    write(file);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    check_member();
+
+    check_index("rb", 1, 0);
+    check_index("rb", 4, 0);
+    check_index("rb", 3, 2);
+    check_index("rbm", 4, 0);
+}
+
+TEST_F(gzio_threads, index_spans_members) {
+    gzFile file;
+
+    /* spans that cross the end of a gzip member are decompressed again on the calling thread */
+    file = open(0);
+    ASSERT_TRUE(file != NULL);
+    for (int i = 0; i < 6; i++) {
+        put(file, data + i * (DATA_SIZE / 6), DATA_SIZE / 6);
+        EXPECT_EQ(zng_gzflush(file, i % 2 ? Z_SYNC_FLUSH : Z_FINISH), Z_OK);
+    }
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    check_read();
+    check_index("rb", 4, 0);
+}
+
+TEST_F(gzio_threads, index_spans_corrupt) {
+    uint8_t *compr = NULL, *out[2];
+    size_t compr_len = 0, got[2];
+    int32_t err;
+    gzFile file;
+    FILE *f;
+
+    out[0] = (uint8_t *)malloc(2 * DATA_SIZE);
+    out[1] = (uint8_t *)malloc(2 * DATA_SIZE);
+    ASSERT_TRUE(out[0] != NULL && out[1] != NULL);
+    file = open(0);
+    ASSERT_TRUE(file != NULL);
+    put(file, data, DATA_SIZE);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+    file = zng_gzopen(TESTFILE, "rb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzindex(file, INDEX_SPAN), 0);
+    EXPECT_EQ(read_all(file, out[0], DATA_SIZE + 1, 1), (size_t)DATA_SIZE);
+    EXPECT_EQ(zng_gzindexsave(file, INDEXFILE), 0);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    /* damage the data in the middle, so that a span fails and is decompressed again to report the error */
+    load(&compr, &compr_len);
+    memset(compr + compr_len / 2, 0xff, 64);
+    f = fopen(TESTFILE, "wb");
+    ASSERT_TRUE(f != NULL);
+    EXPECT_EQ(fwrite(compr, 1, compr_len, f), compr_len);
+    fclose(f);
+    free(compr);
+
+    /* the damage is found by the check of the gzip trailer at the latest -- what is delivered before the error
+       depends on the buffering, the data delivered has to be the same */
+    for (int i = 0; i < 2; i++) {
+        file = zng_gzopen(TESTFILE, "rb");
+        ASSERT_TRUE(file != NULL);
+#ifdef WITH_THREADS
+        EXPECT_EQ(zng_gzsetthreads(file, 3 * i), 0);
+#endif
+        EXPECT_EQ(zng_gzindexload(file, INDEXFILE), 0);
+        got[i] = read_all(file, out[i], 2 * DATA_SIZE, 2);
+        EXPECT_LT(got[i], (size_t)2 * DATA_SIZE);
+        zng_gzerror(file, &err);
+        EXPECT_EQ(err, Z_DATA_ERROR) << "threads " << 3 * i;
+        zng_gzclose(file);
+    }
+    EXPECT_GT(got[1], 0u);
+    EXPECT_EQ(memcmp(out[0], out[1], MIN(got[0], got[1])), 0);
+    free(out[1]);
+    free(out[0]);
+}
@@ -0,0 +1,239 @@
+/* test_inflate_index.cc - Test random access into deflate streams with an access point index */
+
+#include "zbuild.h"
+#include "zlib-ng.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#define DATA_SIZE (1024 * 1024)
+#define INDEX_SPAN (64 * 1024)
+
+class inflate_index : public testing::Test {
+public:
+    uint8_t *data = NULL;
+    uint8_t *compr = NULL;
+    size_t compr_len = 0;
+
+    void SetUp() override {
+        static const char *words[] = { "deflate ", "inflate ", "window ", "block ", "index ", "zlib-ng ", "\n" };
+        uint32_t seed = 1;
+        size_t i = 0;
+
+        data = (uint8_t *)malloc(DATA_SIZE);
+        ASSERT_TRUE(data != NULL);
+        while (i < DATA_SIZE) {
+            seed = seed * 1103515245 + 12345;
+            const char *word = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+            size_t len = MIN(strlen(word), DATA_SIZE - i);
+            memcpy(data + i, word, len);
+            i += len;
+            /* sprinkle in some incompressible bytes */
+            if (((seed >> 8) & 63) == 0 && i < DATA_SIZE)
+                data[i++] = (uint8_t)(seed >> 24);
+        }
+
+        zng_stream strm;
+        memset(&strm, 0, sizeof(strm));
+        ASSERT_EQ(zng_deflateInit2(&strm, 6, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY), Z_OK);
+        compr_len = zng_deflateBound(&strm, DATA_SIZE);
+        compr = (uint8_t *)malloc(compr_len);
+        ASSERT_TRUE(compr != NULL);
+        strm.next_in = data;
+        strm.avail_in = DATA_SIZE;
+        strm.next_out = compr;
+        strm.avail_out = (uint32_t)compr_len;
+        ASSERT_EQ(zng_deflate(&strm, Z_FINISH), Z_STREAM_END);
+        compr_len = strm.total_out;
+        EXPECT_EQ(zng_deflateEnd(&strm), Z_OK);
+    }
+
+    void TearDown() override {
+        free(compr);
+        free(data);
+    }
+
+    /* Build an index, feeding the compressed data in chunks of at most max_in bytes */
+    void build(zng_inflate_index **index, uint32_t max_in) {
+        zng_stream strm;
+        uint8_t *out = (uint8_t *)malloc(DATA_SIZE);
+        size_t in_pos = 0, out_pos = 0;
+        int32_t err;
+
+        ASSERT_TRUE(out != NULL);
+        ASSERT_EQ(zng_inflateIndexInit(index, INDEX_SPAN), Z_OK);
+        memset(&strm, 0, sizeof(strm));
+        ASSERT_EQ(zng_inflateInit2(&strm, MAX_WBITS + 32), Z_OK);
+        do {
+            uint32_t avail_in = (uint32_t)MIN(max_in, compr_len - in_pos);
+            strm.next_in = compr + in_pos;
+            strm.avail_in = avail_in;
+            strm.next_out = out + out_pos;
+            strm.avail_out = (uint32_t)MIN(4096, DATA_SIZE - out_pos);
+            uint32_t avail_out = strm.avail_out;
+            err = zng_inflateIndexBuild(&strm, Z_NO_FLUSH, *index);
+            ASSERT_TRUE(err == Z_OK || err == Z_STREAM_END) << "err " << err;
+            in_pos += avail_in - strm.avail_in;
+            out_pos += avail_out - strm.avail_out;
+        } while (err != Z_STREAM_END);
+        EXPECT_EQ(in_pos, compr_len);
+        EXPECT_EQ(out_pos, (size_t)DATA_SIZE);
+        EXPECT_EQ(memcmp(out, data, DATA_SIZE), 0);
+        EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+        free(out);
+    }
+
+    /* Decompress len bytes at offset using the index and compare them with the original data */
+    void extract(const zng_inflate_index *index, int64_t offset, uint32_t len) {
+        zng_stream strm;
+        uint8_t discard[4096];
+        uint8_t *out = (uint8_t *)malloc(len);
+        int64_t in, start;
+        int32_t err;
+
+        ASSERT_TRUE(out != NULL);
+        memset(&strm, 0, sizeof(strm));
+        ASSERT_EQ(zng_inflateInit2(&strm, -MAX_WBITS), Z_OK);
+        ASSERT_EQ(zng_inflateIndexSeek(&strm, index, offset, &in, &start), Z_OK);
+        EXPECT_LE(start, offset);
+
+        strm.next_in = compr + in;
+        strm.avail_in = (uint32_t)(compr_len - in);
+        while (start < offset) {
+            uint32_t want = (uint32_t)MIN(sizeof(discard), (uint64_t)(offset - start));
+            strm.next_out = discard;
+            strm.avail_out = want;
+            err = zng_inflate(&strm, Z_NO_FLUSH);
+            ASSERT_EQ(err, Z_OK);
+            start += want - strm.avail_out;
+        }
+        strm.next_out = out;
+        strm.avail_out = len;
+        err = zng_inflate(&strm, Z_NO_FLUSH);
+        ASSERT_TRUE(err == Z_OK || err == Z_STREAM_END) << "err " << err;
+        EXPECT_EQ(strm.avail_out, 0u);
+        EXPECT_EQ(memcmp(out, data + offset, len), 0) << "offset " << offset;
+        EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+        free(out);
+    }
+};
+
+TEST_F(inflate_index, seek) {
+    zng_inflate_index *index = NULL;
+
+    build(&index, UINT32_MAX);
+    for (int64_t offset = 0; offset < DATA_SIZE - 1000; offset += 77777)
+        extract(index, offset, 1000);
+    extract(index, DATA_SIZE - 1, 1);
+    EXPECT_EQ(zng_inflateIndexEnd(index), Z_OK);
+}
+
+TEST_F(inflate_index, small_input) {
+    zng_inflate_index *index = NULL;
+
+    build(&index, 13);
+    for (int64_t offset = 12345; offset < DATA_SIZE - 500; offset += 99991)
+        extract(index, offset, 500);
+    EXPECT_EQ(zng_inflateIndexEnd(index), Z_OK);
+}
+
+TEST_F(inflate_index, save_load) {
+    zng_inflate_index *index = NULL, *loaded = NULL;
+    uint8_t *buf, *buf2;
+    size_t len = 0, len2;
+
+    build(&index, UINT32_MAX);
+    ASSERT_EQ(zng_inflateIndexSave(index, NULL, &len), Z_OK);
+    buf = (uint8_t *)malloc(len);
+    ASSERT_TRUE(buf != NULL);
+    len2 = len - 1;
+    EXPECT_EQ(zng_inflateIndexSave(index, buf, &len2), Z_BUF_ERROR);
+    EXPECT_EQ(len2, len);
+    ASSERT_EQ(zng_inflateIndexSave(index, buf, &len), Z_OK);
+
+    EXPECT_EQ(zng_inflateIndexLoad(&loaded, buf, len - 1), Z_DATA_ERROR);
+    ASSERT_EQ(zng_inflateIndexLoad(&loaded, buf, len), Z_OK);
+
+    /* the loaded index serializes to the same bytes */
+    buf2 = (uint8_t *)malloc(len);
+    ASSERT_TRUE(buf2 != NULL);
+    len2 = len;
+    ASSERT_EQ(zng_inflateIndexSave(loaded, buf2, &len2), Z_OK);
+    EXPECT_EQ(len2, len);
+    EXPECT_EQ(memcmp(buf, buf2, len), 0);
+
+    extract(loaded, 500000, 4000);
+
+    buf[0] ^= 1;
+    EXPECT_EQ(zng_inflateIndexLoad(&loaded, buf, len), Z_DATA_ERROR);
+
+    free(buf2);
+    free(buf);
+    EXPECT_EQ(zng_inflateIndexEnd(loaded), Z_OK);
+    EXPECT_EQ(zng_inflateIndexEnd(index), Z_OK);
+}
+
+#ifdef WITH_GZFILEOP
+#define GZ_TESTFILE "index.gz"
+#define GZ_INDEXFILE "index.gz.idx"
+
+/* Seek around in a file of two gzip members with an index built while reading */
+TEST_F(inflate_index, gzseek) {
+    uint8_t *out = (uint8_t *)malloc(DATA_SIZE);
+    z_off64_t offset;
+    gzFile file;
+    FILE *f;
+
+    ASSERT_TRUE(out != NULL);
+    f = fopen(GZ_TESTFILE, "wb");
+    ASSERT_TRUE(f != NULL);
+    EXPECT_EQ(fwrite(compr, 1, compr_len, f), compr_len);
+    EXPECT_EQ(fwrite(compr, 1, compr_len, f), compr_len);
+    fclose(f);
+
+    file = zng_gzopen(GZ_TESTFILE, "rb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzindex(file, 0), -1);
+    EXPECT_EQ(zng_gzindex(file, INDEX_SPAN), 0);
+
+    /* first pass builds the index up to the middle of the second member */
+    EXPECT_EQ(zng_gzread(file, out, DATA_SIZE), DATA_SIZE);
+    EXPECT_EQ(memcmp(out, data, DATA_SIZE), 0);
+    EXPECT_EQ(zng_gzseek(file, DATA_SIZE + 300000, SEEK_SET), DATA_SIZE + 300000);
+    EXPECT_EQ(zng_gzread(file, out, 1000), 1000);
+    EXPECT_EQ(memcmp(out, data + 300000, 1000), 0);
+
+    /* backwards into both members, and forwards past the end of the index */
+    for (offset = 2 * DATA_SIZE - 5000; offset > 0; offset -= 123457) {
+        EXPECT_EQ(zng_gzseek(file, offset, SEEK_SET), offset);
+        EXPECT_EQ(zng_gzread(file, out, 5000), 5000);
+        EXPECT_EQ(memcmp(out, data + offset % DATA_SIZE, 5000), 0) << "offset " << offset;
+    }
+    EXPECT_EQ(zng_gzseek(file, 2 * DATA_SIZE - 10, SEEK_SET), 2 * DATA_SIZE - 10);
+    EXPECT_EQ(zng_gzread(file, out, 100), 10);
+    EXPECT_TRUE(zng_gzeof(file));
+    EXPECT_EQ(zng_gzindexsave(file, GZ_INDEXFILE), 0);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    /* seek right away with the saved index */
+    file = zng_gzopen(GZ_TESTFILE, "rb");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(zng_gzindexload(file, GZ_TESTFILE), -1);
+    EXPECT_EQ(zng_gzindexload(file, GZ_INDEXFILE), 0);
+    EXPECT_EQ(zng_gzseek(file, DATA_SIZE + 654321, SEEK_SET), DATA_SIZE + 654321);
+    EXPECT_EQ(zng_gzread(file, out, 2000), 2000);
+    EXPECT_EQ(memcmp(out, data + 654321, 2000), 0);
+    EXPECT_EQ(zng_gzrewind(file), 0);
+    EXPECT_EQ(zng_gzread(file, out, DATA_SIZE), DATA_SIZE);
+    EXPECT_EQ(memcmp(out, data, DATA_SIZE), 0);
+    EXPECT_EQ(zng_gzclose(file), Z_OK);
+
+    remove(GZ_INDEXFILE);
+    remove(GZ_TESTFILE);
+    free(out);
+}
+#endif
@@ -0,0 +1,239 @@
+/* test_inflate_params.cc - Test zng_inflateSetParams() and zng_inflateGetParams() */
+
+#include "zbuild.h"
+#include "zlib-ng.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_shared.h"
+
+#include <gtest/gtest.h>
+
+#define DATA_SIZE (200 * 1024)
+
+class inflate_params : public testing::Test {
+public:
+    uint8_t *data = NULL;
+    uint8_t *compr = NULL;
+    size_t compr_len = 0;
+
+    void SetUp() override {
+        data = (uint8_t *)malloc(DATA_SIZE);
+        ASSERT_TRUE(data != NULL);
+        /* distant repeats, so matches reach far back */
+        gen_backref_text(data, DATA_SIZE, 7, 40000, 32000);
+        compress(MAX_WBITS + 16);
+    }
+
+    void TearDown() override {
+        free(compr);
+        free(data);
+    }
+
+    void compress(int window_bits) {
+        zng_stream strm;
+
+        free(compr);
+        memset(&strm, 0, sizeof(strm));
+        ASSERT_EQ(zng_deflateInit2(&strm, 6, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY), Z_OK);
+        compr_len = zng_deflateBound(&strm, DATA_SIZE);
+        compr = (uint8_t *)malloc(compr_len);
+        ASSERT_TRUE(compr != NULL);
+        ASSERT_EQ(deflate_buffer(&strm, data, DATA_SIZE, compr, compr_len), Z_STREAM_END);
+        compr_len = strm.total_out;
+        EXPECT_EQ(zng_deflateEnd(&strm), Z_OK);
+    }
+
+    /* Decompress into a buffer of DATA_SIZE bytes, giving inflate() at most chunk bytes of output at a time */
+    int32_t decompress(zng_stream *strm, uint8_t *out, uint32_t chunk) {
+        size_t out_pos = 0;
+        int32_t err;
+
+        strm->next_in = compr;
+        strm->avail_in = (uint32_t)compr_len;
+        strm->next_out = out;
+        do {
+            strm->avail_out = (uint32_t)MIN(chunk, DATA_SIZE - out_pos);
+            err = zng_inflate(strm, Z_NO_FLUSH);
+            out_pos = strm->next_out - out;
+        } while (err == Z_OK && out_pos < DATA_SIZE);
+        if (err == Z_OK) {
+            strm->avail_out = 0;
+            err = zng_inflate(strm, Z_FINISH);
+        }
+        return err;
+    }
+};
+
+TEST_F(inflate_params, window_output) {
+    zng_stream strm;
+    zng_inflate_param_value param;
+    uint8_t *out = (uint8_t *)malloc(DATA_SIZE);
+    int window = Z_INFLATE_WINDOW_OUTPUT;
+
+    ASSERT_TRUE(out != NULL);
+    memset(&strm, 0, sizeof(strm));
+    ASSERT_EQ(zng_inflateInit2(&strm, MAX_WBITS + 16), Z_OK);
+    param.param = Z_INFLATE_WINDOW;
+    param.buf = &window;
+    param.size = sizeof(window);
+    EXPECT_EQ(zng_inflateSetParams(&strm, &param, 1), Z_OK);
+    window = -1;
+    EXPECT_EQ(zng_inflateGetParams(&strm, &param, 1), Z_OK);
+    EXPECT_EQ(window, Z_INFLATE_WINDOW_OUTPUT);
+
+    EXPECT_EQ(decompress(&strm, out, 1000), Z_STREAM_END);
+    EXPECT_EQ(strm.total_out, (size_t)DATA_SIZE);
+    EXPECT_EQ(memcmp(out, data, DATA_SIZE), 0);
+
+    /* the window policy cannot be changed once output has been produced */
+    window = Z_INFLATE_WINDOW_SLIDING;
+    EXPECT_EQ(zng_inflateSetParams(&strm, &param, 1), Z_STREAM_ERROR);
+    EXPECT_EQ(param.status, Z_STREAM_ERROR);
+    EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+    free(out);
+}
+
+TEST_F(inflate_params, output_size) {
+    zng_stream strm;
+    zng_inflate_param_value param;
+    uint8_t *out = (uint8_t *)malloc(DATA_SIZE);
+    int64_t size;
+
+    ASSERT_TRUE(out != NULL);
+    /* a hint that is too small makes the window grow, one that is negative is rejected */
+    for (size = 0; size <= 65536; size = size * 4 + 100) {
+        memset(&strm, 0, sizeof(strm));
+        ASSERT_EQ(zng_inflateInit2(&strm, MAX_WBITS + 16), Z_OK);
+        param.param = Z_INFLATE_OUTPUT_SIZE;
+        param.buf = &size;
+        param.size = sizeof(size);
+        EXPECT_EQ(zng_inflateSetParams(&strm, &param, 1), Z_OK);
+
+        memset(out, 0, DATA_SIZE);
+        EXPECT_EQ(decompress(&strm, out, 777), Z_STREAM_END) << "size " << size;
+        EXPECT_EQ(memcmp(out, data, DATA_SIZE), 0) << "size " << size;
+        EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+    }
+    size = -1;
+    memset(&strm, 0, sizeof(strm));
+    ASSERT_EQ(zng_inflateInit2(&strm, MAX_WBITS + 16), Z_OK);
+    EXPECT_EQ(zng_inflateSetParams(&strm, &param, 1), Z_STREAM_ERROR);
+    EXPECT_EQ(zng_inflateGetParams(&strm, &param, 1), Z_OK);
+    EXPECT_EQ(size, 0);
+    EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+    free(out);
+}
+
+TEST_F(inflate_params, discard) {
+    zng_stream strm;
+    zng_inflate_param_value params[2];
+    uint8_t out[16];
+    int discard = 1, window = Z_INFLATE_WINDOW_OUTPUT;
+
+    memset(&strm, 0, sizeof(strm));
+    ASSERT_EQ(zng_inflateInit2(&strm, MAX_WBITS + 16), Z_OK);
+    params[0].param = Z_INFLATE_DISCARD;
+    params[0].buf = &discard;
+    params[0].size = sizeof(discard);
+    params[1].param = Z_INFLATE_WINDOW;
+    params[1].buf = &window;
+    params[1].size = sizeof(window);
+    EXPECT_EQ(zng_inflateSetParams(&strm, params, 2), Z_STREAM_ERROR);
+    EXPECT_EQ(params[0].status, Z_STREAM_ERROR);
+    EXPECT_EQ(params[1].status, Z_OK);
+    window = Z_INFLATE_WINDOW_SLIDING;
+    EXPECT_EQ(zng_inflateSetParams(&strm, params, 2), Z_OK);
+
+    /* the whole stream is decoded and checked without touching the output buffer */
+    memset(out, 0x5a, sizeof(out));
+    EXPECT_EQ(inflate_buffer(&strm, compr, compr_len, out, sizeof(out)), Z_STREAM_END);
+    EXPECT_EQ(strm.total_out, (size_t)DATA_SIZE);
+    EXPECT_EQ(strm.avail_in, 0u);
+    EXPECT_EQ(strm.next_out, out);
+    EXPECT_EQ(strm.avail_out, sizeof(out));
+    for (size_t i = 0; i < sizeof(out); i++)
+        EXPECT_EQ(out[i], 0x5a);
+
+    /* a corrupted stream is still detected */
+    EXPECT_EQ(zng_inflateReset(&strm), Z_OK);
+    compr[compr_len - 6] ^= 1;
+    strm.next_in = compr;
+    strm.avail_in = (uint32_t)compr_len;
+    EXPECT_EQ(zng_inflate(&strm, Z_NO_FLUSH), Z_DATA_ERROR);
+    EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+}
+
+TEST_F(inflate_params, verify_check) {
+    zng_stream strm;
+    zng_inflate_param_value param;
+    uint8_t *out = (uint8_t *)malloc(DATA_SIZE);
+    int verify = 0;
+
+    ASSERT_TRUE(out != NULL);
+    compr[compr_len - 6] ^= 1;
+    memset(&strm, 0, sizeof(strm));
+    ASSERT_EQ(zng_inflateInit2(&strm, MAX_WBITS + 16), Z_OK);
+    EXPECT_EQ(decompress(&strm, out, DATA_SIZE), Z_DATA_ERROR);
+
+    EXPECT_EQ(zng_inflateReset(&strm), Z_OK);
+    param.param = Z_INFLATE_VERIFY_CHECK;
+    param.buf = &verify;
+    param.size = sizeof(verify);
+    EXPECT_EQ(zng_inflateSetParams(&strm, &param, 1), Z_OK);
+    verify = 1;
+    EXPECT_EQ(zng_inflateGetParams(&strm, &param, 1), Z_OK);
+    EXPECT_EQ(verify, 0);
+    EXPECT_EQ(decompress(&strm, out, DATA_SIZE), Z_STREAM_END);
+    EXPECT_EQ(memcmp(out, data, DATA_SIZE), 0);
+    EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+    free(out);
+}
+
+TEST_F(inflate_params, errors) {
+    zng_stream strm;
+    zng_inflate_param_value params[3];
+    int a = 0, b = 0;
+    int16_t small = 0;
+
+    memset(&strm, 0, sizeof(strm));
+    ASSERT_EQ(zng_inflateInit(&strm), Z_OK);
+    params[0].param = Z_INFLATE_DISCARD;
+    params[0].buf = &a;
+    params[0].size = sizeof(a);
+    params[1].param = Z_INFLATE_DISCARD;
+    params[1].buf = &b;
+    params[1].size = sizeof(b);
+    EXPECT_EQ(zng_inflateSetParams(&strm, params, 2), Z_BUF_ERROR);
+    EXPECT_EQ(params[0].status, Z_BUF_ERROR);
+    EXPECT_EQ(params[1].status, Z_BUF_ERROR);
+
+    params[1].param = Z_INFLATE_OUTPUT_SIZE;
+    params[1].buf = &small;
+    params[1].size = sizeof(small);
+    EXPECT_EQ(zng_inflateSetParams(&strm, params, 2), Z_BUF_ERROR);
+    EXPECT_EQ(params[0].status, Z_OK);
+    EXPECT_EQ(params[1].status, Z_BUF_ERROR);
+    EXPECT_EQ(zng_inflateGetParams(&strm, params, 2), Z_BUF_ERROR);
+
+    params[1].param = (zng_inflate_param)100;
+    params[1].buf = &b;
+    params[1].size = sizeof(b);
+    params[2].param = Z_INFLATE_WINDOW;
+    params[2].buf = &b;
+    params[2].size = sizeof(b);
+    a = 1;
+    b = 5;
+    EXPECT_EQ(zng_inflateSetParams(&strm, params, 3), Z_STREAM_ERROR);
+    EXPECT_EQ(params[1].status, Z_VERSION_ERROR);
+    EXPECT_EQ(params[2].status, Z_STREAM_ERROR);
+    b = Z_INFLATE_WINDOW_SLIDING;
+    EXPECT_EQ(zng_inflateSetParams(&strm, params, 3), Z_VERSION_ERROR);
+    a = 0;
+    EXPECT_EQ(zng_inflateGetParams(&strm, params, 1), Z_OK);
+    EXPECT_EQ(a, 1);
+    EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+}
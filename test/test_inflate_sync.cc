@@ -73,3 +73,37 @@ TEST(inflate, sync) {
     err = PREFIX(inflateEnd)(&d_stream);
     EXPECT_EQ(err, Z_OK);
 }
+
+TEST(inflate, sync_after_data_error) {
+    PREFIX3(stream) d_stream;
+    uint8_t compr[64], uncompr[100];
+    int err;
+
+    /* fixed block whose first match reaches back before the start of the output */
+    memset(compr, 0xaa, sizeof(compr));
+    compr[0] = 0x03;
+    compr[1] = 0x02;
+
+    memset(&d_stream, 0, sizeof(d_stream));
+    err = PREFIX(inflateInit2)(&d_stream, -MAX_WBITS);
+    EXPECT_EQ(err, Z_OK);
+
+    d_stream.next_in = compr;
+    d_stream.avail_in = sizeof(compr);
+    d_stream.next_out = uncompr;
+    d_stream.avail_out = sizeof(uncompr);
+    err = PREFIX(inflate)(&d_stream, Z_NO_FLUSH);
+    EXPECT_EQ(err, Z_DATA_ERROR);
+    /* input read ahead of the error is handed back, so that no more than one byte is left in the bit buffer */
+    EXPECT_EQ(d_stream.total_in + d_stream.avail_in, sizeof(compr));
+    EXPECT_LE(d_stream.total_in, 3);
+
+    /* there is no flush marker to find */
+    err = PREFIX(inflateSync)(&d_stream);
+    EXPECT_EQ(err, Z_DATA_ERROR);
+    EXPECT_EQ(d_stream.avail_in, 0);
+    EXPECT_EQ(d_stream.total_in, sizeof(compr));
+
+    err = PREFIX(inflateEnd)(&d_stream);
+    EXPECT_EQ(err, Z_OK);
+}
@@ -0,0 +1,95 @@
+/* test_inflate_tables.cc - Test inflate() with dynamic blocks that repeat the code lengths of earlier blocks */
+
+#include "zbuild.h"
+#ifdef ZLIB_COMPAT
+#  include "zlib.h"
+#else
+#  include "zlib-ng.h"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#define MSG_COUNT 12
+#define MSG_SIZE 700
+
+class inflate_tables : public testing::Test {
+public:
+    uint8_t msgs[2][MSG_SIZE];
+    uint8_t compr[MSG_COUNT * MSG_SIZE * 2];
+    size_t ends[MSG_COUNT];
+    /* sequence of messages, identical messages compress to identical dynamic blocks after a full flush */
+    const int order[MSG_COUNT] = { 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 0, 0 };
+
+    void SetUp() override {
+        PREFIX3(stream) strm;
+        uint32_t seed = 1;
+
+        for (int m = 0; m < 2; m++) {
+            for (int i = 0; i < MSG_SIZE; i++) {
+                seed = seed * 1103515245 + 12345;
+                msgs[m][i] = (uint8_t)("{}:,\"0123456789abcdefghijklmnopqrstuvwxyz"[(seed >> 16) % (m ? 40 : 16)]);
+            }
+        }
+
+        memset(&strm, 0, sizeof(strm));
+        ASSERT_EQ(PREFIX(deflateInit2)(&strm, 6, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY), Z_OK);
+        strm.next_out = compr;
+        strm.avail_out = sizeof(compr);
+        for (int i = 0; i < MSG_COUNT; i++) {
+            strm.next_in = msgs[order[i]];
+            strm.avail_in = MSG_SIZE;
+            ASSERT_EQ(PREFIX(deflate)(&strm, Z_FULL_FLUSH), Z_OK);
+            ends[i] = (size_t)strm.total_out;
+        }
+        /* the stream is left unfinished, as a message stream would be */
+        EXPECT_EQ(PREFIX(deflateEnd)(&strm), Z_DATA_ERROR);
+    }
+
+    /* Decompress each message feeding at most max_in bytes at a time, continuing on a copy of the stream if
+       requested, and compare it with the original */
+    void decompress(uint32_t max_in, bool copy) {
+        PREFIX3(stream) streams[2], *strm = &streams[0];
+        uint8_t out[MSG_SIZE];
+        size_t pos = 0;
+
+        memset(streams, 0, sizeof(streams));
+        ASSERT_EQ(PREFIX(inflateInit2)(strm, -MAX_WBITS), Z_OK);
+        for (int i = 0; i < MSG_COUNT; i++) {
+            strm->next_out = out;
+            strm->avail_out = sizeof(out);
+            while (pos < ends[i]) {
+                strm->next_in = compr + pos;
+                strm->avail_in = (uint32_t)MIN(max_in, ends[i] - pos);
+                ASSERT_EQ(PREFIX(inflate)(strm, Z_SYNC_FLUSH), Z_OK) << "message " << i;
+                pos = strm->next_in - compr;
+                if (copy) {
+                    PREFIX3(stream) *dest = strm == &streams[0] ? &streams[1] : &streams[0];
+                    ASSERT_EQ(PREFIX(inflateCopy)(dest, strm), Z_OK);
+                    EXPECT_EQ(PREFIX(inflateEnd)(strm), Z_OK);
+                    strm = dest;
+                }
+            }
+            EXPECT_EQ(strm->avail_out, 0u) << "message " << i;
+            EXPECT_EQ(memcmp(out, msgs[order[i]], MSG_SIZE), 0) << "message " << i;
+        }
+        EXPECT_EQ(PREFIX(inflateEnd)(strm), Z_OK);
+    }
+};
+
+TEST_F(inflate_tables, repeat) {
+    decompress(UINT32_MAX, false);
+}
+
+TEST_F(inflate_tables, repeat_small_input) {
+    decompress(1, false);
+    decompress(7, false);
+}
+
+TEST_F(inflate_tables, repeat_copy) {
+    decompress(3, true);
+}
@@ -1,2 +1,64 @@
 static const char hello[] = "hello, hello!";
 static const int hello_len = sizeof(hello);
+
+/* Fills data with len lowercase letters. After the first start bytes, three out of four bytes repeat one of the dist
+   bytes before them, so that deflate finds many short matches. */
+static inline void gen_backref_text(uint8_t *data, size_t len, uint32_t seed, size_t start, size_t dist) {
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (i >= start && (seed >> 20) % 4) ? data[i - 1 - (seed >> 8) % dist] : 'a' + (seed >> 16) % 26;
+    }
+}
+
+/* The stream helpers use the names of zbuild.h, which test_compress_dual.cc, built against another zlib, doesn't use */
+#ifdef PREFIX
+/* Compresses in_len bytes at in with an initialized stream into at most out_size bytes at out. Returns what deflate()
+   returns with Z_FINISH, the compressed length is left in total_out. */
+static inline int32_t deflate_buffer(PREFIX3(stream) *strm, const uint8_t *in, size_t in_len, uint8_t *out,
+                                     size_t out_size) {
+    strm->next_in = (z_const unsigned char *)in;
+    strm->avail_in = (uint32_t)in_len;
+    strm->next_out = out;
+    strm->avail_out = (uint32_t)out_size;
+    return PREFIX(deflate)(strm, Z_FINISH);
+}
+
+/* Decompresses in_len bytes at in with an initialized stream into at most out_size bytes at out. Returns what
+   inflate() returns with Z_FINISH, the decompressed length is left in total_out. */
+static inline int32_t inflate_buffer(PREFIX3(stream) *strm, const uint8_t *in, size_t in_len, uint8_t *out,
+                                     size_t out_size) {
+    strm->next_in = (z_const unsigned char *)in;
+    strm->avail_in = (uint32_t)in_len;
+    strm->next_out = out;
+    strm->avail_out = (uint32_t)out_size;
+    return PREFIX(inflate)(strm, Z_FINISH);
+}
+
+/* Compresses with the given level and windowBits, returns the compressed length, or 0 on error */
+static inline size_t compress_buffer(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_size, int32_t level,
+                                     int32_t window_bits) {
+    PREFIX3(stream) strm;
+    size_t len;
+
+    memset(&strm, 0, sizeof(strm));
+    if (PREFIX(deflateInit2)(&strm, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+    len = deflate_buffer(&strm, in, in_len, out, out_size) == Z_STREAM_END ? (size_t)strm.total_out : 0;
+    PREFIX(deflateEnd)(&strm);
+    return len;
+}
+
+/* Decompresses a stream with the given windowBits, returns the decompressed length, or 0 on error */
+static inline size_t uncompress_buffer(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_size,
+                                       int32_t window_bits) {
+    PREFIX3(stream) strm;
+    size_t len;
+
+    memset(&strm, 0, sizeof(strm));
+    if (PREFIX(inflateInit2)(&strm, window_bits) != Z_OK)
+        return 0;
+    len = inflate_buffer(&strm, in, in_len, out, out_size) == Z_STREAM_END ? (size_t)strm.total_out : 0;
+    PREFIX(inflateEnd)(&strm);
+    return len;
+}
+#endif
@@ -0,0 +1,204 @@
+/* test_stats.cc - Test zng_deflateGetStats() and zng_inflateGetStats() */
+
+#include "zbuild.h"
+#include "zlib-ng.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_shared.h"
+
+#include <gtest/gtest.h>
+
+#define DATA_SIZE (200 * 1024)
+
+class stats : public testing::Test {
+public:
+    uint8_t *data = NULL;
+    uint8_t *compr = NULL;
+    size_t compr_len = 0;
+
+    void SetUp() override {
+        data = (uint8_t *)malloc(DATA_SIZE);
+        ASSERT_TRUE(data != NULL);
+        gen_backref_text(data, DATA_SIZE, 11, 1000, 1000);
+    }
+
+    void TearDown() override {
+        free(compr);
+        free(data);
+    }
+
+    static int32_t set_stats(zng_stream *strm, int deflate, int val) {
+        if (deflate) {
+            zng_deflate_param_value param = { Z_DEFLATE_STATS, &val, sizeof(val), 0 };
+            return zng_deflateSetParams(strm, &param, 1);
+        } else {
+            zng_inflate_param_value param = { Z_INFLATE_STATS, &val, sizeof(val), 0 };
+            return zng_inflateSetParams(strm, &param, 1);
+        }
+    }
+
+    /* Compress data with statistics, returns false if they are not supported by this build */
+    bool compress(int level, int strategy, zng_deflate_stats *st) {
+        zng_stream strm;
+        int32_t err;
+
+        free(compr);
+        memset(&strm, 0, sizeof(strm));
+        EXPECT_EQ(zng_deflateInit2(&strm, level, Z_DEFLATED, MAX_WBITS, 8, strategy), Z_OK);
+        err = set_stats(&strm, 1, 1);
+        if (err == Z_VERSION_ERROR) {
+            EXPECT_EQ(zng_deflateGetStats(&strm, st, sizeof(*st)), Z_VERSION_ERROR);
+            zng_deflateEnd(&strm);
+            compr = NULL;
+            return false;
+        }
+        EXPECT_EQ(err, Z_OK);
+        compr_len = zng_deflateBound(&strm, DATA_SIZE);
+        compr = (uint8_t *)malloc(compr_len);
+        EXPECT_TRUE(compr != NULL);
+        EXPECT_EQ(deflate_buffer(&strm, data, DATA_SIZE, compr, compr_len), Z_STREAM_END);
+        compr_len = strm.total_out;
+        EXPECT_EQ(zng_deflateGetStats(&strm, st, sizeof(*st)), Z_OK);
+        EXPECT_EQ(zng_deflateEnd(&strm), Z_OK);
+        return true;
+    }
+
+    void decompress(zng_inflate_stats *st) {
+        zng_stream strm;
+        uint8_t *out = (uint8_t *)malloc(DATA_SIZE);
+
+        ASSERT_TRUE(out != NULL);
+        memset(&strm, 0, sizeof(strm));
+        ASSERT_EQ(zng_inflateInit2(&strm, MAX_WBITS), Z_OK);
+        ASSERT_EQ(set_stats(&strm, 0, 1), Z_OK);
+        EXPECT_EQ(inflate_buffer(&strm, compr, compr_len, out, DATA_SIZE), Z_STREAM_END);
+        EXPECT_EQ(memcmp(out, data, DATA_SIZE), 0);
+        EXPECT_EQ(zng_inflateGetStats(&strm, st, sizeof(*st)), Z_OK);
+        EXPECT_EQ(zng_inflateEnd(&strm), Z_OK);
+        free(out);
+    }
+
+    void check(int level, int strategy, int expected) {
+        zng_deflate_stats dst;
+        zng_inflate_stats ist;
+        uint64_t lengths = 0, dists = 0;
+
+        if (!compress(level, strategy, &dst))
+            GTEST_SKIP() << "built without WITH_STATS";
+
+        for (int i = 0; i < 29; i++)
+            lengths += dst.length_codes[i];
+        for (int i = 0; i < 30; i++)
+            dists += dst.dist_codes[i];
+        EXPECT_EQ(lengths, dst.matches);
+        EXPECT_EQ(dists, dst.matches);
+        EXPECT_EQ(dst.stored_bytes + dst.fixed_bytes + dst.dynamic_bytes, (uint64_t)DATA_SIZE);
+        EXPECT_GT(dst.stored_blocks + dst.fixed_blocks + dst.dynamic_blocks, 0u);
+        if (level != 0 && strategy != Z_HUFFMAN_ONLY) {
+            EXPECT_GT(dst.matches, 0u);
+        }
+        EXPECT_GT(dst.strategy_calls[expected], 0u);
+        for (int i = 0; i < Z_STATS_STRATEGIES; i++) {
+            if (i != expected) {
+                EXPECT_EQ(dst.strategy_calls[i], 0u);
+                EXPECT_EQ(dst.strategy_ns[i], 0u);
+            }
+        }
+        if (expected == Z_STATS_FAST || expected == Z_STATS_MEDIUM || expected == Z_STATS_SLOW) {
+            EXPECT_GT(dst.chain_searches, 0u);
+            EXPECT_GE(dst.chain_steps, dst.chain_searches);
+            EXPECT_GT(dst.chain_max, 0u);
+            EXPECT_LE(dst.chain_max, dst.chain_steps);
+        } else {
+            EXPECT_EQ(dst.chain_searches, 0u);
+        }
+        if (level != 0) {
+            EXPECT_GT(dst.slide_hash_calls, 0u);
+            EXPECT_EQ(dst.window_bytes_moved, dst.slide_hash_calls << MAX_WBITS);
+        }
+
+        decompress(&ist);
+        EXPECT_EQ(ist.stored_blocks, dst.stored_blocks);
+        EXPECT_EQ(ist.fixed_blocks, dst.fixed_blocks);
+        EXPECT_EQ(ist.dynamic_blocks, dst.dynamic_blocks);
+        EXPECT_LE(ist.table_builds, dst.dynamic_blocks * 3);
+        EXPECT_GE(ist.table_builds, dst.dynamic_blocks ? 3u : 0u);
+        EXPECT_EQ(ist.fast_bytes + ist.slow_bytes, (uint64_t)DATA_SIZE);
+    }
+};
+
+TEST_F(stats, stored) {
+    check(0, Z_DEFAULT_STRATEGY, Z_STATS_STORED);
+}
+
+TEST_F(stats, huffman) {
+    check(6, Z_HUFFMAN_ONLY, Z_STATS_HUFFMAN);
+}
+
+TEST_F(stats, rle) {
+    check(6, Z_RLE, Z_STATS_RLE);
+}
+
+TEST_F(stats, fast) {
+    check(2, Z_DEFAULT_STRATEGY, Z_STATS_FAST);
+}
+
+TEST_F(stats, slow) {
+    check(9, Z_DEFAULT_STRATEGY, Z_STATS_SLOW);
+}
+
+#ifndef NO_QUICK_STRATEGY
+TEST_F(stats, quick) {
+    check(1, Z_DEFAULT_STRATEGY, Z_STATS_QUICK);
+}
+#endif
+
+#ifndef NO_MEDIUM_STRATEGY
+TEST_F(stats, medium) {
+    check(6, Z_DEFAULT_STRATEGY, Z_STATS_MEDIUM);
+}
+#endif
+
+TEST_F(stats, enable) {
+    zng_stream strm;
+    zng_deflate_stats st;
+    zng_deflate_param_value param;
+    int val = -1;
+
+    memset(&strm, 0, sizeof(strm));
+    ASSERT_EQ(zng_deflateInit(&strm, 6), Z_OK);
+
+    /* off by default, and disabling always succeeds */
+    param = { Z_DEFLATE_STATS, &val, sizeof(val), 0 };
+    EXPECT_EQ(zng_deflateGetParams(&strm, &param, 1), Z_OK);
+    EXPECT_EQ(val, 0);
+    EXPECT_EQ(zng_deflateGetStats(&strm, &st, sizeof(st)), Z_VERSION_ERROR);
+    EXPECT_EQ(set_stats(&strm, 1, 0), Z_OK);
+    if (set_stats(&strm, 1, 1) == Z_VERSION_ERROR) {
+        zng_deflateEnd(&strm);
+        GTEST_SKIP() << "built without WITH_STATS";
+    }
+    EXPECT_EQ(zng_deflateGetParams(&strm, &param, 1), Z_OK);
+    EXPECT_EQ(val, 1);
+
+    /* counters are cleared by a reset, and a short size leaves the rest of the structure alone */
+    strm.next_in = data;
+    strm.avail_in = DATA_SIZE;
+    uint8_t out[1024];
+    strm.next_out = out;
+    strm.avail_out = sizeof(out);
+    EXPECT_EQ(zng_deflate(&strm, Z_NO_FLUSH), Z_OK);
+    memset(&st, 0xff, sizeof(st));
+    EXPECT_EQ(zng_deflateGetStats(&strm, &st, offsetof(zng_deflate_stats, matches)), Z_OK);
+    EXPECT_GT(st.literals, 0u);
+    EXPECT_EQ(st.matches, UINT64_MAX);
+    EXPECT_EQ(zng_deflateReset(&strm), Z_OK);
+    EXPECT_EQ(zng_deflateGetStats(&strm, &st, sizeof(st)), Z_OK);
+    EXPECT_EQ(st.literals, 0u);
+    EXPECT_EQ(st.strategy_calls[Z_STATS_MEDIUM] + st.strategy_calls[Z_STATS_SLOW], 0u);
+    EXPECT_EQ(zng_deflateEnd(&strm), Z_OK);
+}
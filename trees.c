@@ -35,6 +35,7 @@
 #include "trees.h"
 #include "trees_emit.h"
 #include "trees_tbl.h"
+#include "zprobe.h"
 
 /* The lengths of the bit length codes are sent in order of decreasing
  * probability, to avoid transmitting the lengths for unused bit length codes.
@@ -607,6 +608,7 @@ void Z_INTERNAL zng_tr_stored_block(deflate_state *s, char *buf, uint32_t stored
         cmpr_bits_add(s, stored_len << 3);
         sent_bits_add(s, stored_len << 3);
     }
+    DEFLATE_STAT(s, stored_bytes, stored_len);
 }
 
 /* ===========================================================================
@@ -637,6 +639,8 @@ void Z_INTERNAL zng_tr_flush_block(deflate_state *s, char *buf, uint32_t stored_
     unsigned long opt_lenb, static_lenb; /* opt_len and static_len in bytes */
     int max_blindex = 0;  /* index of last bit length code of non zero freq */
 
+    PROBE2(deflate_block_start, stored_len, last);
+
     /* Build the Huffman trees unless a stored block is forced */
     if (UNLIKELY(s->sym_next == 0)) {
         /* Emit an empty static tree block with no codes */
@@ -687,16 +691,21 @@ void Z_INTERNAL zng_tr_flush_block(deflate_state *s, char *buf, uint32_t stored_
          * transform a block into a stored block.
          */
         zng_tr_stored_block(s, buf, stored_len, last);
+        PROBE3(deflate_block_end, STORED_BLOCK, stored_len, last);
 
     } else if (s->strategy == Z_FIXED || static_lenb == opt_lenb) {
         zng_tr_emit_tree(s, STATIC_TREES, last);
         compress_block(s, (const ct_data *)static_ltree, (const ct_data *)static_dtree);
         cmpr_bits_add(s, s->static_len);
+        DEFLATE_STAT(s, fixed_bytes, stored_len);
+        PROBE3(deflate_block_end, STATIC_TREES, stored_len, last);
     } else {
         zng_tr_emit_tree(s, DYN_TREES, last);
         send_all_trees(s, s->l_desc.max_code+1, s->d_desc.max_code+1, max_blindex+1);
         compress_block(s, (const ct_data *)s->dyn_ltree, (const ct_data *)s->dyn_dtree);
         cmpr_bits_add(s, s->opt_len);
+        DEFLATE_STAT(s, dynamic_bytes, stored_len);
+        PROBE3(deflate_block_end, DYN_TREES, stored_len, last);
     }
     Assert(s->compressed_len == s->bits_sent, "bad compressed size");
     /* The above check is made mod 2^32, for files larger than 512 MB
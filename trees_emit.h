@@ -108,6 +108,7 @@ static inline uint32_t zng_emit_lit(deflate_state *s, const ct_data *ltree, unsi
     s->bi_valid = bi_valid;
     s->bi_buf = bi_buf;
 
+    DEFLATE_STAT(s, literals, 1);
     Tracecv(isgraph(c & 0xff), (stderr, " '%c' ", c));
 
     return ltree[c].Len;
@@ -130,6 +131,8 @@ static inline uint32_t zng_emit_dist(deflate_state *s, const ct_data *ltree, con
     c = code+LITERALS+1;
     Assert(c < L_CODES, "bad l_code");
     send_code_trace(s, c);
+    DEFLATE_STAT(s, matches, 1);
+    DEFLATE_STAT(s, length_codes[code], 1);
 
     match_bits = ltree[c].Code;
     match_bits_len = ltree[c].Len;
@@ -144,6 +147,7 @@ static inline uint32_t zng_emit_dist(deflate_state *s, const ct_data *ltree, con
     code = d_code(dist);
     Assert(code < D_CODES, "bad d_code");
     send_code_trace(s, code);
+    DEFLATE_STAT(s, dist_codes[code], 1);
 
     /* Send the distance code */
     match_bits |= ((uint64_t)dtree[code].Code << match_bits_len);
@@ -203,6 +207,9 @@ static inline void zng_tr_emit_tree(deflate_state *s, int type, const int last)
     cmpr_bits_add(s, 3);
     s->bi_valid = bi_valid;
     s->bi_buf = bi_buf;
+    DEFLATE_STAT(s, stored_blocks, type == STORED_BLOCK);
+    DEFLATE_STAT(s, fixed_blocks, type == STATIC_TREES);
+    DEFLATE_STAT(s, dynamic_blocks, type == DYN_TREES);
     Tracev((stderr, "\n--- Emit Tree: Last: %u\n", last));
 }
 
@@ -5,6 +5,60 @@
 
 #include "zbuild.h"
 #include "zutil.h"
+#include "inftrees.h"
+#include "inflate.h"
+#include "zthread.h"
+
+/* ===========================================================================
+ * Decompresses with a stream that is newly initialized or reset, see uncompress2().
+ */
+static int uncompress_stream(PREFIX3(stream) *stream, unsigned char *dest, z_size_t *destLen,
+                             const unsigned char *source, z_size_t *sourceLen) {
+    int err;
+    const unsigned int max = (unsigned int)-1;
+    z_size_t len, left;
+    unsigned char buf[1];    /* for detection of incomplete stream when *destLen == 0 */
+
+    len = *sourceLen;
+    if (*destLen) {
+        left = *destLen;
+        *destLen = 0;
+    } else {
+        left = 1;
+        dest = buf;
+    }
+
+    stream->next_in = (z_const unsigned char *)source;
+    stream->avail_in = 0;
+    /* all output goes to dest, so the history can be read from there */
+    PREFIX(inflate_windowless)(stream);
+
+    stream->next_out = dest;
+    stream->avail_out = 0;
+
+    do {
+        if (stream->avail_out == 0) {
+            stream->avail_out = left > (unsigned long)max ? max : (unsigned int)left;
+            left -= stream->avail_out;
+        }
+        if (stream->avail_in == 0) {
+            stream->avail_in = len > (unsigned long)max ? max : (unsigned int)len;
+            len -= stream->avail_in;
+        }
+        err = PREFIX(inflate)(stream, Z_NO_FLUSH);
+    } while (err == Z_OK);
+
+    *sourceLen -= len + stream->avail_in;
+    if (dest != buf)
+        *destLen = (z_size_t)stream->total_out;
+    else if (stream->total_out && err == Z_BUF_ERROR)
+        left = 1;
+
+    return err == Z_STREAM_END ? Z_OK :
+           err == Z_NEED_DICT ? Z_DATA_ERROR  :
+           err == Z_BUF_ERROR && left + stream->avail_out ? Z_DATA_ERROR :
+           err;
+}
 
 /* ===========================================================================
      Decompresses the source buffer into the destination buffer.  *sourceLen is
@@ -25,18 +79,6 @@
 int Z_EXPORT PREFIX(uncompress2)(unsigned char *dest, z_size_t *destLen, const unsigned char *source, z_size_t *sourceLen) {
     PREFIX3(stream) stream;
     int err;
-    const unsigned int max = (unsigned int)-1;
-    z_size_t len, left;
-    unsigned char buf[1];    /* for detection of incomplete stream when *destLen == 0 */
-
-    len = *sourceLen;
-    if (*destLen) {
-        left = *destLen;
-        *destLen = 0;
-    } else {
-        left = 1;
-        dest = buf;
-    }
 
     stream.next_in = (z_const unsigned char *)source;
     stream.avail_in = 0;
@@ -47,34 +89,81 @@ int Z_EXPORT PREFIX(uncompress2)(unsigned char *dest, z_size_t *destLen, const u
     err = PREFIX(inflateInit)(&stream);
     if (err != Z_OK) return err;
 
-    stream.next_out = dest;
-    stream.avail_out = 0;
-
-    do {
-        if (stream.avail_out == 0) {
-            stream.avail_out = left > (unsigned long)max ? max : (unsigned int)left;
-            left -= stream.avail_out;
-        }
-        if (stream.avail_in == 0) {
-            stream.avail_in = len > (unsigned long)max ? max : (unsigned int)len;
-            len -= stream.avail_in;
-        }
-        err = PREFIX(inflate)(&stream, Z_NO_FLUSH);
-    } while (err == Z_OK);
-
-    *sourceLen -= len + stream.avail_in;
-    if (dest != buf)
-        *destLen = (z_size_t)stream.total_out;
-    else if (stream.total_out && err == Z_BUF_ERROR)
-        left = 1;
-
+    err = uncompress_stream(&stream, dest, destLen, source, sourceLen);
     PREFIX(inflateEnd)(&stream);
-    return err == Z_STREAM_END ? Z_OK :
-           err == Z_NEED_DICT ? Z_DATA_ERROR  :
-           err == Z_BUF_ERROR && left + stream.avail_out ? Z_DATA_ERROR :
-           err;
+    return err;
 }
 
 int Z_EXPORT PREFIX(uncompress)(unsigned char *dest, z_size_t *destLen, const unsigned char *source, z_size_t sourceLen) {
     return PREFIX(uncompress2)(dest, destLen, source, &sourceLen);
 }
+
+#ifndef ZLIB_COMPAT
+typedef struct {
+    zng_batch_item *items;
+    size_t count;
+    size_t next;            /* next item to decompress */
+    zmutex lock;            /* protects next */
+} uncompress_batch;
+
+/* Decompresses items of a batch with one stream, reset between items, until all of them are taken */
+static void uncompress_batch_worker(void *arg) {
+    uncompress_batch *batch = (uncompress_batch *)arg;
+    zng_batch_item *item;
+    zng_stream stream;
+    size_t i;
+    int used = 0;
+
+    stream.next_in = NULL;
+    stream.avail_in = 0;
+    stream.zalloc = NULL;
+    stream.zfree = NULL;
+    stream.opaque = NULL;
+
+    /* leave the items to the other workers if this one has no memory */
+    if (zng_inflateInit(&stream) != Z_OK)
+        return;
+
+    for (;;) {
+        zmutex_lock(&batch->lock);
+        i = batch->next++;
+        zmutex_unlock(&batch->lock);
+        if (i >= batch->count)
+            break;
+
+        item = &batch->items[i];
+        if (used)
+            zng_inflateReset(&stream);
+        item->status = uncompress_stream(&stream, item->dest, &item->dest_len, item->src, &item->src_len);
+        used = 1;
+    }
+    zng_inflateEnd(&stream);
+}
+
+int32_t Z_EXPORT zng_uncompress_batch(zng_batch_item *items, size_t count, int32_t threads) {
+    uncompress_batch batch;
+    size_t i;
+
+    if (items == NULL && count != 0)
+        return Z_STREAM_ERROR;
+
+    /* items no worker gets to for lack of memory keep this */
+    for (i = 0; i < count; i++)
+        items[i].status = Z_MEM_ERROR;
+    if (count == 0)
+        return Z_OK;
+
+    batch.items = items;
+    batch.count = count;
+    batch.next = 0;
+    zmutex_init(&batch.lock);
+    zthread_run(uncompress_batch_worker, &batch, (int32_t)MIN((size_t)MAX(threads, 1), count));
+    zmutex_destroy(&batch.lock);
+
+    for (i = 0; i < count; i++) {
+        if (items[i].status != Z_OK)
+            return items[i].status;
+    }
+    return Z_OK;
+}
+#endif
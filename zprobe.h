@@ -0,0 +1,31 @@
+#ifndef ZPROBE_H_
+#define ZPROBE_H_
+
+/* zprobe.h -- static tracepoints in deflate and inflate
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+/* With WITH_PROBES, PROBEn() places a USDT probe named zlib:name, which perf, bpftrace and SystemTap can attach to,
+ * e.g. bpftrace -e 'usdt:libz-ng.so:zlib:deflate_block_start { @[arg0] = count(); }'. A probe is a single nop until
+ * a tracer attaches, but its arguments are still computed, so they should be values that are at hand anyway.
+ * Without WITH_PROBES, the probes and their arguments compile to nothing.
+ */
+#ifdef WITH_PROBES
+#  include <sys/sdt.h>
+#  define PROBE0(name)          STAP_PROBE(zlib, name)
+#  define PROBE1(name, a)       STAP_PROBE1(zlib, name, a)
+#  define PROBE2(name, a, b)    STAP_PROBE2(zlib, name, a, b)
+#  define PROBE3(name, a, b, c) STAP_PROBE3(zlib, name, a, b, c)
+#else
+#  define PROBE0(name)          do {} while (0)
+#  define PROBE1(name, a)       do {} while (0)
+#  define PROBE2(name, a, b)    do {} while (0)
+#  define PROBE3(name, a, b, c) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+/* zthread.c -- internal worker threads
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include "zbuild.h"
+#include "zthread.h"
+
+#ifdef WITH_THREADS
+#ifdef _WIN32
+static DWORD WINAPI zthread_start(LPVOID arg) {
+    zthread *thread = (zthread *)arg;
+    thread->fn(thread->arg);
+    return 0;
+}
+
+int Z_INTERNAL zthread_create(zthread *thread, void (*fn)(void *arg), void *arg) {
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, zthread_start, thread, 0, NULL);
+    return thread->handle == NULL ? -1 : 0;
+}
+
+void Z_INTERNAL zthread_join(zthread *thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+#else
+static void *zthread_start(void *arg) {
+    zthread *thread = (zthread *)arg;
+    thread->fn(thread->arg);
+    return NULL;
+}
+
+int Z_INTERNAL zthread_create(zthread *thread, void (*fn)(void *arg), void *arg) {
+    thread->fn = fn;
+    thread->arg = arg;
+    return pthread_create(&thread->handle, NULL, zthread_start, thread) ? -1 : 0;
+}
+
+void Z_INTERNAL zthread_join(zthread *thread) {
+    pthread_join(thread->handle, NULL);
+}
+#endif
+#endif
+
+void Z_INTERNAL zthread_run(void (*fn)(void *arg), void *arg, int32_t threads) {
+#ifdef WITH_THREADS
+    zthread workers[ZTHREAD_MAX - 1];
+    int32_t started = 0;
+
+    threads = MIN(threads, ZTHREAD_MAX);
+    while (started < threads - 1 && zthread_create(&workers[started], fn, arg) == 0)
+        started++;
+    fn(arg);
+    while (started > 0)
+        zthread_join(&workers[--started]);
+#else
+    Z_UNUSED(threads);
+    fn(arg);
+#endif
+}
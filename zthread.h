@@ -0,0 +1,190 @@
+#ifndef ZTHREAD_H_
+#define ZTHREAD_H_
+
+/* zthread.h -- header to use zthread.c
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+/* Maximum number of threads, including the calling one, zthread_run() runs a function on */
+#define ZTHREAD_MAX 64
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#endif
+
+#ifdef WITH_THREADS
+#  ifdef _WIN32
+typedef SRWLOCK zmutex;
+
+static inline void zmutex_init(zmutex *mutex) {
+    InitializeSRWLock(mutex);
+}
+static inline void zmutex_destroy(zmutex *mutex) {
+    Z_UNUSED(mutex);
+}
+static inline void zmutex_lock(zmutex *mutex) {
+    AcquireSRWLockExclusive(mutex);
+}
+static inline void zmutex_unlock(zmutex *mutex) {
+    ReleaseSRWLockExclusive(mutex);
+}
+
+typedef CONDITION_VARIABLE zcond;
+
+static inline void zcond_init(zcond *cond) {
+    InitializeConditionVariable(cond);
+}
+static inline void zcond_destroy(zcond *cond) {
+    Z_UNUSED(cond);
+}
+static inline void zcond_wait(zcond *cond, zmutex *mutex) {
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+}
+static inline void zcond_broadcast(zcond *cond) {
+    WakeAllConditionVariable(cond);
+}
+
+typedef struct zthread_s {
+    HANDLE handle;
+    void (*fn)(void *arg);
+    void *arg;
+} zthread;
+#  else
+#    include <pthread.h>
+typedef pthread_mutex_t zmutex;
+
+static inline void zmutex_init(zmutex *mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+static inline void zmutex_destroy(zmutex *mutex) {
+    pthread_mutex_destroy(mutex);
+}
+static inline void zmutex_lock(zmutex *mutex) {
+    pthread_mutex_lock(mutex);
+}
+static inline void zmutex_unlock(zmutex *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+typedef pthread_cond_t zcond;
+
+static inline void zcond_init(zcond *cond) {
+    pthread_cond_init(cond, NULL);
+}
+static inline void zcond_destroy(zcond *cond) {
+    pthread_cond_destroy(cond);
+}
+static inline void zcond_wait(zcond *cond, zmutex *mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+static inline void zcond_broadcast(zcond *cond) {
+    pthread_cond_broadcast(cond);
+}
+
+typedef struct zthread_s {
+    pthread_t handle;
+    void (*fn)(void *arg);
+    void *arg;
+} zthread;
+#  endif
+
+/* Start a thread running fn(arg), returns 0 on success. thread must stay valid until zthread_join(). */
+int Z_INTERNAL zthread_create(zthread *thread, void (*fn)(void *arg), void *arg);
+/* Wait for a thread started by zthread_create() to finish */
+void Z_INTERNAL zthread_join(zthread *thread);
+#else
+/* Without threads everything runs on the calling thread, and locking is not needed. There is nothing to wait
+   for either, so zcond is only available with threads. */
+typedef int zmutex;
+
+static inline void zmutex_init(zmutex *mutex) {
+    Z_UNUSED(mutex);
+}
+static inline void zmutex_destroy(zmutex *mutex) {
+    Z_UNUSED(mutex);
+}
+static inline void zmutex_lock(zmutex *mutex) {
+    Z_UNUSED(mutex);
+}
+static inline void zmutex_unlock(zmutex *mutex) {
+    Z_UNUSED(mutex);
+}
+
+#endif
+
+/* zonce_run() runs fn() once for the whole process, and returns only after it finished. That holds without
+   WITH_THREADS too, since the application can still call zlib-ng from several threads of its own. */
+#if defined(_WIN32)
+typedef INIT_ONCE zonce;
+#  define ZONCE_INIT INIT_ONCE_STATIC_INIT
+
+static inline BOOL CALLBACK zonce_start(PINIT_ONCE once, PVOID arg, PVOID *context) {
+    Z_UNUSED(once);
+    Z_UNUSED(context);
+    (*(void (**)(void))arg)();
+    return TRUE;
+}
+static inline void zonce_run(zonce *once, void (*fn)(void)) {
+    InitOnceExecuteOnce(once, zonce_start, (PVOID)&fn, NULL);
+}
+#elif defined(WITH_THREADS)
+typedef pthread_once_t zonce;
+#  define ZONCE_INIT PTHREAD_ONCE_INIT
+
+static inline void zonce_run(zonce *once, void (*fn)(void)) {
+    pthread_once(once, fn);
+}
+#elif defined(__GNUC__)
+/* The state is 0 before fn() runs, 1 while the first caller runs it, and 2 once it returned. Other callers spin
+   until then, which is short since fn() only detects and resolves. */
+typedef int zonce;
+#  define ZONCE_INIT 0
+
+static inline void zonce_run(zonce *once, void (*fn)(void)) {
+    int state = 0;
+
+    if (__atomic_load_n(once, __ATOMIC_ACQUIRE) == 2)
+        return;
+    if (__atomic_compare_exchange_n(once, &state, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        fn();
+        __atomic_store_n(once, 2, __ATOMIC_RELEASE);
+        return;
+    }
+    while (__atomic_load_n(once, __ATOMIC_ACQUIRE) != 2)
+        ;
+}
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#  include <stdatomic.h>
+typedef atomic_int zonce;
+#  define ZONCE_INIT 0
+
+static inline void zonce_run(zonce *once, void (*fn)(void)) {
+    int state = 0;
+
+    if (atomic_load(once) == 2)
+        return;
+    if (atomic_compare_exchange_strong(once, &state, 1)) {
+        fn();
+        atomic_store(once, 2);
+        return;
+    }
+    while (atomic_load(once) != 2)
+        ;
+}
+#else
+#  error "zonce_run() needs WITH_THREADS, or a compiler with __atomic builtins or C11 atomics"
+#endif
+
+/* Run fn(arg) on up to threads threads, one of them the calling thread, and return once all of them finished.
+   Fewer threads are used if they cannot be started, at least the calling thread runs fn(arg). */
+void Z_INTERNAL zthread_run(void (*fn)(void *arg), void *arg, int32_t threads);
+
+#endif /* ZTHREAD_H_ */